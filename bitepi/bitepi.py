@@ -1,16 +1,23 @@
+import concurrent.futures
 import glob
 import logging
 import os
+import threading
 import uuid
 
 import numpy
 import pandas
 
-from bitepimodule import bitepi
+from bitepimodule import bitepi, Job, Session, Stream
 
 
 logger = logging.getLogger(__name__)
 BITEPI_BINARY = 'BitEpi.o'
+PIN_POLICIES = ('compact', 'cores', 'scatter')
+HUGE_PAGE_MODES = ('thp', 'explicit')
+SPLIT_MODES = ('auto', 'snps', 'samples')
+RETURN_CANCELLED = 2
+RETURN_STOPPED = 3
 OUTPUT_SUFFIXES = {
     'Purity.0.csv': 'p1',
     'Purity.1.csv': 'p2',
@@ -20,8 +27,35 @@ OUTPUT_SUFFIXES = {
     'IG.1.csv': 'ig2',
     'IG.2.csv': 'ig3',
     'IG.3.csv': 'ig4',
+    'Purity.0.csv.gz': 'p1',
+    'Purity.1.csv.gz': 'p2',
+    'Purity.2.csv.gz': 'p3',
+    'Purity.3.csv.gz': 'p4',
+    'IG.0.csv.gz': 'ig1',
+    'IG.1.csv.gz': 'ig2',
+    'IG.2.csv.gz': 'ig3',
+    'IG.3.csv.gz': 'ig4',
     'bestIG.csv': 'best_ig',
+    'plan.csv': 'plan',
+    'sketch.csv': 'sketch',
+    'histogram.csv': 'histogram',
+    'coverage.csv': 'coverage',
 }
+# association metrics other than the gini purity, by flag and output name
+METRICS = {
+    'mi': 'MI',
+    'chi2': 'Chi2',
+    'or': 'LogOR',
+}
+for _flag, _name in METRICS.items():
+    for _order in range(4):
+        for _extension in ('csv', 'csv.gz'):
+            _suffix = '{}.{}'.format(_order, _extension)
+            OUTPUT_SUFFIXES[_name + '.' + _suffix] = 'p{}:{}'.format(
+                _order + 1, _flag)
+            OUTPUT_SUFFIXES[_name + '_Gain.' + _suffix] = 'ig{}:{}'.format(
+                _order + 1, _flag)
+    OUTPUT_SUFFIXES['bestIG.{}.csv'.format(_name)] = 'best_ig:' + _flag
 
 
 class ReturnCodeError(Exception):
@@ -29,6 +63,40 @@ class ReturnCodeError(Exception):
     pass
 
 
+class EpistasisFuture(concurrent.futures.Future):
+    """A Future of an analysis that can be cancelled while it runs."""
+    def __init__(self):
+        super().__init__()
+        self._job = Job()
+
+    def cancel(self):
+        """Cancel the analysis.
+
+        An analysis that hasn't started will not run. A running
+        analysis stops its threads at the next work unit, removes its
+        partial output, and result() raises
+        concurrent.futures.CancelledError.
+
+        :return: False if the analysis has already finished, otherwise
+            True.
+        """
+        if super().cancel():
+            return True
+        if self.done():
+            return False
+        logger.info("Cancelling running analysis")
+        self._job.cancel()
+        return True
+
+    def cancelled(self):
+        """Return True if the analysis was cancelled."""
+        if super().cancelled():
+            return True
+        return (self._job.cancelled and self.done()
+                and isinstance(self.exception(),
+                               concurrent.futures.CancelledError))
+
+
 class Epistasis(object):
     """Calculate epistasis interactions given cases and controls."""
     def __init__(self, genotype_array, sample_array, working_directory='/tmp',
@@ -72,10 +140,23 @@ class Epistasis(object):
         self._array_csv = self._get_random_filename()
         self._array_list = self._create_array_list()
         self._write_to_csv()
+        self._session = None
+        self._session_args = None
+        self._session_lock = threading.Lock()
 
     def compute_epistasis(self, p1=None, p2=None, p3=None, p4=None, ig1=None,
                           ig2=None, ig3=None, ig4=None, threads=2, sort=False,
-                          best_ig=False):
+                          best_ig=False, pin=None, numa=False,
+                          huge_pages=None, plan=False, targets=None,
+                          annotations=None, max_dist=None, cis=False,
+                          trans=False, same_group=False,
+                          cross_group=False, compress=False,
+                          cache_dir=None, metrics=None,
+                          best_ig_metrics=None, collapse=False,
+                          fused=False, stream=False, sketch=False,
+                          early=False, time_budget=None, save_state=None,
+                          resume=None, counts=None, sparse=None,
+                          model=None, split=None):
         """Compute the epistasis interactions for each SNP combination.
 
         Call the BitEpi binary object with the provided arguments and
@@ -84,6 +165,15 @@ class Epistasis(object):
         Contains logging. For more verbose output set logging to
         logging.INFO or logging.DEBUG
 
+        The binary runs without holding the GIL. A KeyboardInterrupt
+        while waiting cancels the analysis before being re-raised.
+
+        The dataset is read by the binary once, on the first call, and
+        kept for later calls along with the purities they have saved.
+        A later call that computes information gain reuses the purities
+        of the lower orders instead of computing them again. Calls may
+        run at the same time from several threads.
+
         :param p1: Float that specifies that gini purity should be
             calculated  when cases and controls are split over
             individual SNPs. 0 <= p1 < 1, and represents the threshold
@@ -128,7 +218,178 @@ class Epistasis(object):
         :param best_ig: Creates a single output "best_ig", that contains
             only the most informative pair, triplet and quadlet for each
             SNP. This ignores the threshold arguments and takes O(n^4)
-            time.
+            time. An integer K > 1 keeps the K most informative pairs,
+            triplets and quadlets of each SNP instead, in K rows per
+            SNP ranked by a RANK column. Ranks without a combination of
+            positive information gain are left empty.
+        :param pin: Pin the threads to cpus (Linux only). One of
+            "compact" (fill the SMT siblings of a core before moving to
+            the next core), "cores" (one thread per physical core, node
+            by node, before using SMT siblings) or "scatter" (one thread
+            per physical core, alternating between NUMA nodes, before
+            using SMT siblings). None leaves placement to the OS.
+        :param numa: Replicate the genotype data on each NUMA node used
+            by the threads, so that each thread reads node-local
+            memory. Implies pin="scatter" if pin is not set.
+        :param huge_pages: Back the genotype data with huge pages
+            (Linux only). Either "thp" for transparent huge pages or
+            "explicit" for pre-allocated huge pages, falling back to
+            transparent huge pages if none are available. Only the
+            first call reads the dataset, so later calls keep its
+            setting.
+        :param plan: Don't run the analysis. Instead read only the
+            dimensions of the dataset, calibrate the kernels of the
+            requested orders on this machine, and return a single
+            output "plan" with the predicted memory of each structure,
+            the predicted run time of each order with the requested
+            number of threads, and recommended settings.
+        :param targets: A list of SNP names. Only the combinations
+            that include at least one of these SNPs are computed and
+            recorded, with the targets first in the order of this list,
+            then the other SNPs in the order of the genotype array. The
+            rows of "best_ig" are in the same order. Individual SNPs are
+            only recorded if they are targets, and in "best_ig" the
+            other SNPs only consider their combinations with targets.
+            SNPs not in the genotype array are ignored.
+        :param annotations: An array with one row per SNP: the SNP
+            name, its chromosome, its position and optionally its
+            group (e.g. a pathway). Column names, if present, are
+            ignored. Can be a list of lists, numpy array, or a pandas
+            dataframe. Needed by the constraints below, which are only
+            applied to combinations of two or more SNPs. Unannotated
+            SNPs are not combined with any other SNP.
+        :param max_dist: Only combinations of SNPs on the same
+            chromosome that are at most this many base pairs apart.
+        :param cis: Only combinations of SNPs on the same chromosome.
+        :param trans: Only combinations of SNPs on different
+            chromosomes. Cannot be used with cis or max_dist.
+        :param same_group: Only combinations of SNPs in the same group.
+        :param cross_group: Only combinations of SNPs in different
+            groups. Cannot be used with same_group, max_dist or trans.
+        :param compress: Have the binary gzip the purity and
+            information gain CSVs it writes in working_directory, which
+            are several times smaller. The returned dataframes are the
+            same.
+        :param cache_dir: A directory in which the binary keeps the
+            purities it saves, in files named after a hash of the
+            dataset. A later call, even from another process, on the
+            same dataset maps them instead of computing them again.
+            Files of other datasets are ignored.
+        :param metrics: A dictionary of other association metrics to
+            compute from the same contingency tables as the purity,
+            keyed by "p" or "ig", the order and the metric, e.g.
+            {"p2:mi": 0, "ig3:chi2": 10}. The metrics are "mi" (mutual
+            information in bits), "chi2" (chi-square statistic) and
+            "or" (largest absolute log odds ratio of a genotype against
+            the others). "ig" keys give the gain of the metric: its
+            value minus the largest of its sub-combinations. Values are
+            thresholds >= 0, or -1 for benchmarking, and each key
+            produces an output under the same key.
+        :param best_ig_metrics: A list of metrics, for each of which a
+            single output "best_ig:<metric>" is created like "best_ig",
+            ranked by the gain of the metric. Its value and gain
+            columns are named after the metric (e.g. PAIR_MI and
+            PAIR_MI_GAIN), and it also ignores the threshold arguments.
+        :param collapse: Have the binary keep one SNP of each set of
+            SNPs with identical genotypes, and drop the SNPs with the
+            same genotype in every sample. Combinations are computed
+            once per set and reported under every name of the set, but
+            combinations of two SNPs of one set, or with a dropped SNP,
+            are not reported. In "best_ig" the partners are named by
+            the first SNP of their set. Only the first call reads the
+            dataset, so later calls keep its setting, and annotations
+            only apply to that first SNP.
+        :param fused: Compute every requested order in one traversal of
+            the combinations, instead of one pass per order, so that
+            e.g. best_ig reads the genotypes of each prefix once for
+            all four orders. The results are the same.
+        :param stream: Return a generator instead of a dictionary, so
+            that results can be filtered or stored as they are
+            computed instead of being written to working_directory and
+            read back in full. The analysis starts at the first next()
+            and yields (key, batch) tuples, where key is an output key
+            below and batch a numpy record array of up to 65536 rows
+            with the columns of that output. Batches of several
+            outputs are interleaved, in no particular order. The
+            binary waits while a few batches are left unread, so the
+            memory used does not grow with the number of results.
+            Outputs that are only complete at the end, such as
+            "best_ig", are yielded last as a single batch. Closing the
+            generator early cancels the analysis.
+        :param sketch: Also summarise the distribution of the purity
+            and information gain of every order computed, including
+            the orders computed only for information gain, without
+            writing every combination. Produces an output "sketch"
+            with one row per ORDER and MEASURE ("Purity" or "IG"):
+            COUNT, MIN, the quantiles Q01 to Q9999 (e.g. Q99 is the
+            99th percentile, within about 1% in rank) and MAX. And an
+            output "histogram" with the exact number of combinations
+            in each non-empty bin of width 0.001 (LOW to HIGH), and
+            ABOVE, the number at or above LOW, from which a threshold
+            can be chosen for a given number of results.
+        :param early: Count the samples of each pair, triplet or
+            quadlet in blocks, and stop as soon as the samples left
+            cannot bring it to the p2-4 or ig2-4 threshold of its
+            order. The results are the same, and high thresholds are
+            reached faster. Only applies to orders whose results are
+            all thresholded and not needed otherwise, i.e. not with
+            best_ig, sketch, metrics or fused, nor to an order whose
+            purity the next order's information gain needs.
+        :param time_budget: Stop the analysis after this many seconds
+            and return the results of the combinations processed so
+            far: the thresholded outputs hold only those, and
+            "best_ig" the best of them. Produces an output "coverage"
+            with one row per ORDER computed: COMBINATIONS processed,
+            TOTAL to process and their FRACTION. The first SNPs of
+            the dataset (or the targets) are taken first, and a
+            combination is never partly processed.
+        :param save_state: A file to which the SNPs and the "best_ig"
+            results are saved once the analysis is complete. Needs
+            best_ig, and cannot be used with targets, annotations or
+            collapse.
+        :param resume: A file saved by save_state from an analysis of
+            part of the SNPs, such as before new SNPs were appended.
+            Only the combinations that include a SNP missing from it
+            are computed, and "best_ig" is the same as for a full
+            analysis. The SNPs it has must keep their names and
+            genotypes, and the samples must be the same. With the
+            same restrictions as save_state, and without fused,
+            sketch or best_ig_metrics. Both can be given to save the
+            combined results for the next resume.
+        :param counts: A file of the genotype counts of every SNP and
+            pair of SNPs, to which the samples of this dataset are
+            added as a new batch. The file is created if missing, and
+            later batches must have the same SNPs in the same order.
+            p1, p2, ig1, ig2 and best_ig (for SNPs and pairs only) are
+            then computed over all the samples counted so far, as if
+            the batches were one dataset, without reading the earlier
+            samples again. The file is only updated once the analysis
+            is complete, and takes 72 bytes per pair. Cannot be used
+            with p3, p4, ig3, ig4, targets, annotations, collapse,
+            fused, early, metrics, best_ig_metrics, save_state or
+            resume.
+        :param sparse: An alternate allele frequency below which a SNP
+            is also kept as the list of the samples that carry it. A
+            combination whose last SNP is such a rare SNP is counted
+            from its carriers only, so that combinations of rare
+            variants take time with the number of carriers rather
+            than samples. The results are the same.
+        :param model: 'dominant' (0 against 1 or 2) or 'recessive'
+            (0 or 1 against 2) to recode the genotypes when the
+            dataset is read, or 'additive' (the default) to keep them.
+            The binary genotypes are counted one bit per sample, with
+            2, 4, 8 or 16 cells for orders 1 to 4, which is several
+            times faster. Only the first call reads the dataset, so
+            later calls keep its model.
+        :param split: How the threads share the combinations of an
+            order. "snps" gives each thread whole first SNPs, which
+            leaves the threads unbalanced when there are few SNPs.
+            "samples" has every thread count its share of the samples
+            of each combination, with the partial tables summed before
+            the purity. "auto" (the default) splits the samples when
+            the first SNPs would leave the busiest thread 25% above the
+            average and each thread has at least 512 samples. Targets,
+            annotations, resume, counts and early keep the first SNPs.
         :return:
             A dictionary of pandas dataframes, one for each output.
             Each row of a dataframe represents an interaction, except
@@ -147,11 +408,84 @@ class Epistasis(object):
                 PAIR/TRIPLET/QUADLET_1/2/3 - Additional SNPs
                     participating in the relevant interactions with SNP.
                     Only present in "best_ig".
+                RANK - Rank of the interactions in the row among those
+                    of SNP, from 1. Only present in "best_ig" when
+                    best_ig is an integer above 1.
+            With stream=True, a generator of (key, batch) tuples
+            instead.
         :raises bitepi.ReturnCodeError: If the binary returns a non-zero
             error code.
         :raises ValueError: If the thresholds are set to values other
             than -1, or in the half-open range [0, 1). If threads is not
-            a positive integer.
+            a positive integer, or best_ig is neither a boolean nor a
+            positive integer. If pin, huge_pages or split are not one of the
+            listed values. If targets is empty. If a constraint is given
+            without annotations, or the constraints conflict, or
+            annotations is given along with targets. If cache_dir
+            contains the argument delimiter. If a key of metrics or a
+            metric of best_ig_metrics is not listed, or a metric
+            threshold is neither -1 nor >= 0. If collapse is given
+            along with annotations. If stream is given along with sort
+            or plan. If time_budget is not positive. If save_state or
+            resume is given without best_ig or with an option they
+            cannot be used with, or contains the argument delimiter.
+            If counts is given with an option it cannot be used with,
+            or contains the argument delimiter. If sparse is not in
+            (0, 1]. If model is not 'additive', 'dominant' or
+            'recessive'. If the file given by resume, counts, targets or
+            annotations cannot be used, or collapse leaves no SNP.
+        """
+        kwargs = dict(locals())
+        del kwargs['self']
+        if stream:
+            args, output_prefix = self._build_args(**kwargs)
+            return self._stream(args, output_prefix)
+        future = self.compute_epistasis_async(**kwargs)
+        try:
+            return future.result()
+        except KeyboardInterrupt:
+            logger.warning("Interrupted, cancelling the analysis.")
+            future.cancel()
+            concurrent.futures.wait([future])
+            raise
+
+    def compute_epistasis_async(self, **kwargs):
+        """Start compute_epistasis in a background thread.
+
+        The binary runs without holding the GIL, so other Python
+        threads keep running while it works.
+
+        :param kwargs: The same arguments as compute_epistasis.
+        :return: An EpistasisFuture, whose result() is the dictionary
+            returned by compute_epistasis, and whose cancel() stops the
+            analysis even if it is already running.
+        :raises ValueError: As compute_epistasis, before starting, or
+            if stream is given.
+        """
+        if kwargs.get('stream'):
+            raise ValueError("stream is only supported by"
+                             " compute_epistasis")
+        args, output_prefix = self._build_args(**kwargs)
+        future = EpistasisFuture()
+        thread = threading.Thread(target=self._run,
+                                  args=(future, args, output_prefix),
+                                  daemon=True)
+        thread.start()
+        return future
+
+    def _build_args(self, p1=None, p2=None, p3=None, p4=None, ig1=None,
+                    ig2=None, ig3=None, ig4=None, threads=2, sort=False,
+                    best_ig=False, pin=None, numa=False, huge_pages=None,
+                    plan=False, targets=None, annotations=None,
+                    max_dist=None, cis=False, trans=False, same_group=False,
+                    cross_group=False, compress=False, cache_dir=None,
+                    metrics=None, best_ig_metrics=None, collapse=False,
+                    fused=False, stream=False, sketch=False,
+                    early=False, time_budget=None, save_state=None,
+                    resume=None, counts=None, sparse=None, model=None,
+                    split=None):
+        """Validate the arguments of compute_epistasis and convert them
+        to arguments of the binary.
         """
         # Check threads argument
         if int(threads) != threads:
@@ -159,6 +493,20 @@ class Epistasis(object):
             raise ValueError("threads must be a positive integer, got "
                              + str(threads))
 
+        if pin is not None and pin not in PIN_POLICIES:
+            logger.error("Got invalid argument pin=%s", pin)
+            raise ValueError("pin must be one of " + ', '.join(PIN_POLICIES)
+                             + ", got " + str(pin))
+        if split is not None and split not in SPLIT_MODES:
+            logger.error("Got invalid argument split=%s", split)
+            raise ValueError("split must be one of " + ', '.join(SPLIT_MODES)
+                             + ", got " + str(split))
+        if huge_pages is not None and huge_pages not in HUGE_PAGE_MODES:
+            logger.error("Got invalid argument huge_pages=%s", huge_pages)
+            raise ValueError("huge_pages must be one of "
+                             + ', '.join(HUGE_PAGE_MODES) + ", got "
+                             + str(huge_pages))
+
         thresholds = {
             '-p1': p1,
             '-p2': p2,
@@ -186,22 +534,269 @@ class Epistasis(object):
                                   value=value)
                     )
                     raise ValueError(error_string)
+        for key, value in (metrics or {}).items():
+            if key not in OUTPUT_SUFFIXES.values() or ':' not in key \
+                    or key.startswith('best_ig'):
+                logger.error("Got invalid metric %s", key)
+                raise ValueError("metrics keys must be p1-4 or ig1-4, ':' and"
+                                 " one of " + ', '.join(METRICS) + ", got "
+                                 + str(key))
+            if value == -1:  # Benchmark only - no results
+                args.append('-' + key)
+            elif value >= 0:
+                args += ['-' + key, str(value)]
+            else:
+                logger.error("Got invalid argument %s=%s", key, value)
+                raise ValueError("Metric thresholds must be >= 0, or -1 for"
+                                 " benchmarking. {} is {}.".format(key, value))
+        for metric in best_ig_metrics or ():
+            if metric not in METRICS:
+                logger.error("Got invalid best_ig metric %s", metric)
+                raise ValueError("best_ig_metrics must be among "
+                                 + ', '.join(METRICS) + ", got " + str(metric))
+            args.append('-bestIG:' + metric)
+        if stream and (sort or plan):
+            logger.error("Got stream along with sort or plan")
+            raise ValueError("stream cannot be used with sort or plan")
         output_prefix = os.path.join(self._working_directory, uuid.uuid4().hex)
+        if plan:
+            # a plan reads only the dimensions of the dataset
+            args += ['-i', self._array_csv]
         args += [
-            '-i', self._array_csv,
             '-o', output_prefix,
             '-t', str(threads),
         ]
         if sort:
             args.append('-sort')
-        if best_ig:
+        if compress:
+            args.append('-gz')
+        if best_ig not in (True, False, None):
+            if int(best_ig) != best_ig or best_ig < 1:
+                logger.error("Got invalid argument best_ig=%s", best_ig)
+                raise ValueError("best_ig must be a boolean or a positive"
+                                 " integer, got " + str(best_ig))
+        if best_ig is True or best_ig == 1:
             args.append('-bestIG')
+        elif best_ig:
+            args += ['-bestIG', str(int(best_ig))]
+        if pin is not None:
+            args += ['-pin', pin]
+        if split is not None:
+            args += ['-split', split]
+        if numa:
+            args.append('-numa')
+        if huge_pages is not None:
+            args += ['-hugePages', huge_pages]
+        if collapse:
+            args.append('-collapse')
+        if model is not None:
+            if model not in ('additive', 'dominant', 'recessive'):
+                logger.error("Got invalid argument model=%s", model)
+                raise ValueError("model must be 'additive', 'dominant' or"
+                                 " 'recessive', got " + str(model))
+            args += ['-model', model]
+        if fused:
+            args.append('-fused')
+        if sketch:
+            args.append('-sketch')
+        if early:
+            args.append('-early')
+        if time_budget is not None:
+            if not time_budget > 0:
+                logger.error("Got invalid argument time_budget=%s",
+                             time_budget)
+                raise ValueError("time_budget must be a positive number of"
+                                 " seconds, got " + str(time_budget))
+            args += ['-timeBudget', str(time_budget)]
+        if sparse is not None:
+            if not 0 < sparse <= 1:
+                logger.error("Got invalid argument sparse=%s", sparse)
+                raise ValueError("sparse must be an allele frequency in"
+                                 " (0, 1], got " + str(sparse))
+            args += ['-sparse', str(sparse)]
+        if plan:
+            args.append('-plan')
+        if cache_dir is not None:
+            if self._arg_delimiter in cache_dir:
+                logger.error("Got invalid argument cache_dir=%s", cache_dir)
+                raise ValueError("cache_dir cannot contain '"
+                                 + self._arg_delimiter + "'")
+            args += ['-cache', cache_dir]
+        for name, path, flag in (('save_state', save_state, '-saveState'),
+                                 ('resume', resume, '-resume')):
+            if path is None:
+                continue
+            if not best_ig or targets is not None \
+                    or annotations is not None or collapse:
+                logger.error("Got %s without best_ig or with targets,"
+                             " annotations or collapse", name)
+                raise ValueError(name + " needs best_ig, and cannot be used"
+                                 " with targets, annotations or collapse")
+            if name == 'resume' and (fused or sketch or best_ig_metrics):
+                logger.error("Got resume with fused, sketch or"
+                             " best_ig_metrics")
+                raise ValueError("resume cannot be used with fused, sketch"
+                                 " or best_ig_metrics")
+            if self._arg_delimiter in path:
+                logger.error("Got invalid argument %s=%s", name, path)
+                raise ValueError(name + " cannot contain '"
+                                 + self._arg_delimiter + "'")
+            args += [flag, path]
+        if counts is not None:
+            if any(value is not None for value in (p3, p4, ig3, ig4,
+                                                   targets, annotations)) \
+                    or collapse or fused or early or metrics \
+                    or best_ig_metrics or save_state or resume:
+                logger.error("Got counts with an option it cannot be used"
+                             " with")
+                raise ValueError("counts cannot be used with p3, p4, ig3,"
+                                 " ig4, targets, annotations, collapse,"
+                                 " fused, early, metrics, best_ig_metrics,"
+                                 " save_state or resume")
+            if self._arg_delimiter in counts:
+                logger.error("Got invalid argument counts=%s", counts)
+                raise ValueError("counts cannot contain '"
+                                 + self._arg_delimiter + "'")
+            args += ['-counts', counts]
+        if targets is not None:
+            if len(targets) == 0:
+                logger.error("Got empty targets")
+                raise ValueError("targets must name at least one SNP")
+            targets_file = self._get_random_filename()
+            with open(targets_file, 'w') as f:
+                f.write('\n'.join(str(target) for target in targets) + '\n')
+            args += ['-targets', targets_file]
+        constraints = {
+            '-cis': cis,
+            '-trans': trans,
+            '-sameGroup': same_group,
+            '-crossGroup': cross_group,
+        }
+        if max_dist is not None:
+            if int(max_dist) != max_dist or max_dist <= 0:
+                logger.error("Got invalid argument max_dist=%s", max_dist)
+                raise ValueError("max_dist must be a positive integer, got "
+                                 + str(max_dist))
+            args += ['-maxDist', str(int(max_dist))]
+        args += [flag for flag, value in constraints.items() if value]
+        if annotations is None:
+            if max_dist is not None or any(constraints.values()):
+                raise ValueError("Constraints need annotations")
+        else:
+            if targets is not None:
+                raise ValueError("annotations and targets cannot be used"
+                                 " together")
+            if collapse:
+                raise ValueError("annotations and collapse cannot be used"
+                                 " together")
+            if ((cis or max_dist is not None) and trans
+                    or same_group and cross_group
+                    or max_dist is not None and cross_group
+                    or trans and cross_group):
+                raise ValueError("Conflicting constraints")
+            annotations_file = self._get_random_filename()
+            with open(annotations_file, 'w') as f:
+                for row in self._convert_to_list(annotations, headers=False):
+                    f.write(','.join(str(value) for value in row) + '\n')
+            args += ['-annot', annotations_file]
+        return args, output_prefix
+
+    def _get_session(self, args):
+        """Return the session holding the dataset, reading it again
+        whenever the arguments it was loaded with differ from args.
+        """
+        load_args = ['bitepi', '-i', self._array_csv]
+        if '-hugePages' in args:
+            index = args.index('-hugePages')
+            load_args += args[index:index + 2]
+        if '-collapse' in args:
+            load_args.append('-collapse')
+        if '-model' in args:
+            index = args.index('-model')
+            load_args += args[index:index + 2]
+        with self._session_lock:
+            if self._session is None or self._session_args != load_args:
+                logger.info("Loading %s", self._array_csv)
+                self._session = Session(self._arg_delimiter,
+                                        self._arg_delimiter.join(load_args))
+                self._session_args = load_args
+            return self._session
+
+    def _run(self, future, args, output_prefix, stream=None):
+        """Run the binary and set the result of the future."""
+        try:
+            if not future.set_running_or_notify_cancel():
+                return
+            try:
+                future.set_result(self._call_binary(future._job, args,
+                                                    output_prefix, stream))
+            except BaseException as e:
+                future.set_exception(e)
+        finally:
+            if stream is not None:
+                stream.finish()
+
+    def _stream(self, args, output_prefix):
+        """Run the binary in a background thread and yield the batches
+        of its stream, then the outputs it has written.
+        """
+        stream = Stream()
+        future = EpistasisFuture()
+        thread = threading.Thread(target=self._run,
+                                  args=(future, args, output_prefix, stream),
+                                  daemon=True)
+        thread.start()
+        try:
+            names = None
+            while True:
+                batch = stream.get()
+                if batch is None:
+                    break
+                name, order, values, variables = batch
+                if names is None:
+                    names = numpy.array(stream.names(), dtype=object)
+                key = OUTPUT_SUFFIXES['{}.{}.csv'.format(name, order)]
+                variables = numpy.frombuffer(variables, dtype=numpy.uint32)
+                variables = variables.reshape(-1, order + 1)
+                columns = [numpy.frombuffer(values, dtype=numpy.float64)]
+                columns += [names[variables[:, o]] for o in range(order + 1)]
+                column_names = [name] + ['SNP_' + chr(ord('A') + o)
+                                         for o in range(order + 1)]
+                yield key, numpy.rec.fromarrays(columns, names=column_names)
+            for key, dataframe in future.result().items():
+                yield key, dataframe.to_records(index=False)
+        finally:
+            if not future.done():
+                logger.info("Stream closed, cancelling the analysis.")
+                stream.close()
+                future.cancel()
+                concurrent.futures.wait([future])
+
+    def _call_binary(self, job, args, output_prefix, stream=None):
+        """Call the binary and read its output CSVs."""
         delimiter = self._arg_delimiter
         argstring = delimiter.join(args)
-        logger.info("Calling: bitepi('%s', '%s'", delimiter,
-                    argstring)
-        return_code = bitepi(delimiter, argstring)
-        if return_code != 0:
+        if job.cancelled:
+            raise concurrent.futures.CancelledError()
+        if '-plan' in args:
+            logger.info("Calling: bitepi('%s', '%s'", delimiter,
+                        argstring)
+            return_code = bitepi(delimiter, argstring, job)
+        else:
+            session = self._get_session(args)
+            logger.info("Calling: session.run('%s', '%s'", delimiter,
+                        argstring)
+            if stream is None:
+                return_code = session.run(delimiter, argstring, job)
+            else:
+                return_code = session.run(delimiter, argstring, job, stream)
+        if return_code == RETURN_CANCELLED:
+            logger.info("Analysis was cancelled.")
+            raise concurrent.futures.CancelledError()
+        if return_code == RETURN_STOPPED:
+            logger.warning("Analysis stopped by its time budget, the results"
+                           " only cover part of the combinations.")
+        elif return_code != 0:
             logger.error("Error when calling binary, got return-code %s.",
                          return_code)
             raise ReturnCodeError(
@@ -1,32 +1,96 @@
 #ifdef _MSC_VER
 	#define _CRT_SECURE_NO_WARNINGS
-	typedef int pthread_mutex_t;
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#define NOGDI // wingdi.h defines ERROR
+	#include "windows.h"
+	#include "process.h"
+
+	// the pthread calls of BitEpi on Windows threads, slim locks and condition variables
+	typedef SRWLOCK pthread_mutex_t;
+	typedef CONDITION_VARIABLE pthread_cond_t;
+	typedef HANDLE pthread_t;
+	typedef int pthread_attr_t;
+	int pthread_mutex_init(pthread_mutex_t *x, void *attr)
+	{
+		InitializeSRWLock(x);
+		return 0;
+	}
+	int pthread_mutex_destroy(pthread_mutex_t *x)
+	{
+		return 0;
+	}
+	int pthread_mutex_lock(pthread_mutex_t *x)
+	{
+		AcquireSRWLockExclusive(x);
+		return 0;
+	}
 	int pthread_mutex_trylock(pthread_mutex_t *x)
 	{
-		if (*x == 0)
-		{
-			*x = 1;
-			return 0;
-		}
-		else
-			return 1;
+		return TryAcquireSRWLockExclusive(x) ? 0 : 1;
 	}
-	void pthread_mutex_init(pthread_mutex_t *x, int *y)
+	int pthread_mutex_unlock(pthread_mutex_t *x)
 	{
-		*x = 0;
+		ReleaseSRWLockExclusive(x);
+		return 0;
 	}
-	typedef int pthread_t;
-	typedef int pthread_attr_t;
-	void pthread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start_routine) (void *), void *arg)
+	int pthread_cond_init(pthread_cond_t *c, void *attr)
 	{
-		(*start_routine)(arg);
+		InitializeConditionVariable(c);
+		return 0;
 	}
-	void pthread_join(pthread_t thread, void **retval)
+	int pthread_cond_destroy(pthread_cond_t *c)
 	{
-		return;
+		return 0;
+	}
+	int pthread_cond_wait(pthread_cond_t *c, pthread_mutex_t *x)
+	{
+		return SleepConditionVariableSRW(c, x, INFINITE, 0) ? 0 : 1;
+	}
+	int pthread_cond_broadcast(pthread_cond_t *c)
+	{
+		WakeAllConditionVariable(c);
+		return 0;
+	}
+	struct ThreadStart
+	{
+		void *(*routine)(void *);
+		void *arg;
+	};
+	unsigned __stdcall StartThread(void *s)
+	{
+		ThreadStart start = *(ThreadStart *)s;
+		delete (ThreadStart *)s;
+		start.routine(start.arg);
+		return 0;
+	}
+	int pthread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start_routine) (void *), void *arg)
+	{
+		ThreadStart *s = new ThreadStart;
+		s->routine = start_routine;
+		s->arg = arg;
+		*thread = (HANDLE)_beginthreadex(NULL, 0, StartThread, s, 0, NULL);
+		if (*thread)
+			return 0;
+		delete s;
+		return 1;
+	}
+	int pthread_join(pthread_t thread, void **retval)
+	{
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+		return 0;
 	}
 #else
 	#include "pthread.h"
+	#include "unistd.h"
+	#include "fcntl.h"
+	#include "sys/stat.h"
+	#include "sys/mman.h"
+#endif
+
+#ifdef __linux__
+	#include "sched.h"
 #endif
 
 #include "stdio.h"
@@ -34,7 +98,9 @@
 #include "string.h"
 #include "time.h"
 #include "math.h"
+#include "signal.h"
 #include "csvparser.h"
+#include "gzwriter.h"
 
 //#define PTEST
 
@@ -54,7 +120,9 @@ typedef unsigned short int sampleIdx; // this type used in contingency table. th
 typedef unsigned long long int word; // for parallel processing
 
 const uint8 cti[81] = {0,1,2,4,5,6,8,9,10,16,17,18,20,21,22,24,25,26,32,33,34,36,37,38,40,41,42,64,65,66,68,69,70,72,73,74,80,81,82,84,85,86,88,89,90,96,97,98,100,101,102,104,105,106,128,129,130,132,133,134,136,137,138,144,145,146,148,149,150,152,153,154,160,161,162,164,165,166,168,169,170 };
+const uint8 bti[16] = {0,1,4,5,16,17,20,21,64,65,68,69,80,81,84,85}; // cells of the tables of binary genotypes (-model dominant or recessive)
 const uint32 byte_in_word = sizeof(word);
+const uint32 bit_in_word = 8 * sizeof(word);
 
 #define MAX_ORDER 4
 
@@ -62,12 +130,88 @@ const uint32 byte_in_word = sizeof(word);
 #define P3(X) (X*X*X)
 #define P4(X) (X*X*X*X)
 
+#define MAX_NODE 8
+#define MAX_CPU 1024
+#define HUGE_PAGE (2 * 1024 * 1024)
+
+// thread pinning policies
+#define PIN_NONE 0
+#define PIN_COMPACT 1 // fill a core's SMT siblings, then the next core, then the next node
+#define PIN_CORES 2   // one thread per physical core (node by node) before using SMT siblings
+#define PIN_SCATTER 3 // one thread per physical core, alternating between nodes, before using SMT siblings
+
+// how the threads of an order share its combinations (-split)
+#define SPLIT_AUTO 0    // the samples when the first positions cannot keep the threads equally busy, else the first positions
+#define SPLIT_SNPS 1    // the first positions, each thread counts every sample of its combinations
+#define SPLIT_SAMPLES 2 // the samples, every thread counts its share of the samples of every combination
+#define SPLIT_BATCH 256      // combinations counted by the threads between two reductions of their partial tables
+#define SPLIT_IMBALANCE 1.25 // -split auto: combinations of the busiest thread over the average above which the samples are split
+#define SPLIT_MIN_WORDS 64   // -split auto: words of samples per thread below which the first positions are kept
+
+// genotype memory backing
+#define PAGE_DEFAULT 0
+#define PAGE_TRANSPARENT 1 // transparent huge pages (madvise)
+#define PAGE_EXPLICIT 2    // explicit huge pages (hugetlbfs), falls back to transparent
+
+// genotype models the dataset is recoded to when loaded (-model)
+#define MODEL_ADDITIVE 0  // genotypes 0, 1 and 2 as read
+#define MODEL_DOMINANT 1  // 0 against 1 or 2
+#define MODEL_RECESSIVE 2 // 0 or 1 against 2
+
+// the binary genotypes are counted with the popcnt instruction where the cpu has it
+#ifdef _MSC_VER
+#define POPCOUNT(X) __popcnt64(X)
+#define POPCOUNT_CLONES
+#else
+#define POPCOUNT(X) __builtin_popcountll(X)
+#if defined(__x86_64__) && !defined(__clang__)
+#define POPCOUNT_CLONES __attribute__((target_clones("popcnt", "default")))
+#else
+#define POPCOUNT_CLONES
+#endif
+#endif
+
+#define RETURN_CANCELLED 2 // main() was cancelled through its cancel flag
+#define RETURN_STOPPED 3   // -timeBudget or a signal stopped the run, the results cover part of the combinations
+#define RETURN_INVALID 4   // the dataset or a file of the run (-targets, -annot, -resume, -counts) cannot be used
+
+// association metrics computed from the contingency tables of the purity (-p2:mi, -ig3:chi2, -bestIG:or)
+#define METRIC_MI 0    // mutual information of the genotypes and the labels, in bits
+#define METRIC_CHI2 1  // chi-square statistic of the genotype by label table
+#define METRIC_LOGOR 2 // largest absolute log odds ratio of a genotype against the others (0.5 added to each count)
+#define NUM_METRIC 3
+const char *metricFlag[NUM_METRIC] = { "mi", "chi2", "or" };
+const char *metricName[NUM_METRIC] = { "MI", "Chi2", "LogOR" };
+
+// output records handed from the compute threads to the writer thread
+#define OUT_PURITY 0
+#define OUT_IG 1
+#define OUT_METRIC 2 // the value of metric k is output OUT_METRIC + 2 * k, its gain OUT_METRIC + 2 * k + 1
+#define NUM_OUT (OUT_METRIC + 2 * NUM_METRIC)
+const char *outName[NUM_OUT] = { "Purity", "IG", "MI", "MI_Gain", "Chi2", "Chi2_Gain", "LogOR", "LogOR_Gain" };
+#define RING_SIZE 16384          // records queued by each compute thread (power of 2)
+#define OUT_BUFFER (1024 * 1024) // text of a thread file formatted before each write
+
+// -sort: runs sorted in memory by the writer thread, then merged by value ranges in parallel
+#define SORT_MEMORY (256ULL * 1024 * 1024) // run and merge sort buffers shared by the thread files of an order
+#define SORT_MIN_RUN (64 * 1024)            // smallest run, in records
+#define MERGE_MEMORY (64ULL * 1024 * 1024)  // read buffers shared by the runs of every part of a merge
+#define MERGE_MIN_BUFFER 256                // records read at once from a run
+#define MERGE_MAX_BUFFER (64 * 1024)
+#define MERGE_MIN_PART (1024 * 1024)        // records below which the merge is not split
+#define MERGE_SAMPLE 64                     // values sampled from each run to split the merge
+
+#define EARLY_BLOCKS 16         // most blocks of samples counted between the bounds of -early
+#define EARLY_BLOCK_SAMPLES 512 // fewest samples of a block of -early
+#define EARLY_MARGIN 1e-9       // purity kept above a bound, so rounding never drops a reported combination
+
+#define STREAM_BATCH (64 * 1024) // records of a batch handed to the caller of a streamed run
+#define STREAM_DEPTH 8           // batches queued before the writers wait for the caller
+
 #define ERROR(X) {printf("*** ERROR: %s (line:%u - File %s)\n", X, __LINE__, __FILE__); exit(0);}
 #define NULL_CHECK(X) {if(!X) {printf("*** ERROR: %s is null (line:%u - File %s)\n", #X, __LINE__, __FILE__); exit(0);}}
-
-double ***tripletPurity;
-double **PairPurity;
-double *SnpPurity;
+// an input that cannot be used returns false to the caller instead of exiting, a session must not end its host process
+#define INPUT_ERROR(X) {printf("*** ERROR: %s (line:%u - File %s)\n", X, __LINE__, __FILE__); return false;}
 
 union WordByte
 {
@@ -83,22 +227,101 @@ struct ARGS
 	bool computeIG[MAX_ORDER];// [N] should we compute IG of order of N
 	bool printIG[MAX_ORDER];  // [N] should we report IG of order of N in it meets the threshold ig[N]
 	bool bestIG;			  // [N] should we compute the best IG
+	uint32 bestK;             // combinations kept for each SNP and order by -bestIG
 
 	double p[MAX_ORDER];
 	double ig[MAX_ORDER];
 
+	// the same flags for each other metric (METRIC_XXX), its gain is its value minus the largest of its sub-combinations
+	bool computeM[NUM_METRIC][MAX_ORDER];
+	bool printM[NUM_METRIC][MAX_ORDER];
+	bool saveM[NUM_METRIC][MAX_ORDER];
+	bool computeMG[NUM_METRIC][MAX_ORDER];
+	bool printMG[NUM_METRIC][MAX_ORDER];
+	bool bestM[NUM_METRIC];
+	double m[NUM_METRIC][MAX_ORDER];
+	double mg[NUM_METRIC][MAX_ORDER];
+	bool metrics; // any other metric is computed
+
 	char input[1024];
 	char output[1024];
+	char targets[1024]; // file of target SNP names, one per line (-targets)
+	char annot[1024];   // file of SNP annotations: name,chromosome,position[,group] (-annot)
+	char cache[1024];   // directory of the purity cache files (-cache)
+	char resume[1024];  // state file of an earlier -bestIG run on part of the SNPs, only combinations with a new SNP are added (-resume)
+	char saveState[1024]; // file the SNPs and bestIG results of the run are saved to for a later -resume (-saveState)
+	char counts[1024];  // file of the genotype counts of the SNPs and pairs over the sample batches so far (-counts)
+	uint64 maxDist;     // largest distance between the SNPs of a combination (0 for any)
+	bool cis;           // all SNPs of a combination on the same chromosome
+	bool trans;         // all SNPs of a combination on different chromosomes
+	bool sameGroup;     // all SNPs of a combination in the same group
+	bool crossGroup;    // all SNPs of a combination in different groups
 	uint32 numThreads;
 	uint32 order;
 
 	bool sort;
+	bool gz; // gzip compress the purity and IG files
+	bool fused; // compute every order in one traversal of the combinations
+	bool sketch; // report the distribution of the purity and IG of every order computed
+	bool early;  // stop counting a combination once it cannot reach the thresholds of its order
+	double timeBudget; // seconds after which the run stops and writes the results so far (0 for none)
+	double sparse;     // SNPs with an alternate allele frequency below it are also kept as carrier lists (0 for none)
+
+	uint32 pinPolicy; // PIN_XXX
+	uint32 split;     // SPLIT_XXX
+	bool numa;        // replicate genotype data on each NUMA node used by the threads
+	uint32 hugePages; // PAGE_XXX
+	bool collapse;    // keep one SNP of each set with identical genotypes and drop the monomorphic SNPs
+	uint32 model;     // MODEL_XXX the genotypes are recoded to when the dataset is loaded
+
+	bool plan; // only predict memory and run time
+
+	// whether output m (OUT_XXX) of an order is reported
+	bool Prints(uint32 m, uint32 o)
+	{
+		if (m == OUT_PURITY)
+			return printP[o];
+		if (m == OUT_IG)
+			return printIG[o];
+		uint32 k = (m - OUT_METRIC) / 2;
+		return ((m - OUT_METRIC) % 2) ? printMG[k][o] : printM[k][o];
+	}
+
+	// whether another metric is computed for an order
+	bool UsesMetrics(uint32 o)
+	{
+		for (uint32 k = 0; k < NUM_METRIC; k++)
+			if (computeM[k][o])
+				return true;
+		return false;
+	}
+
+	// whether the combinations of an order are only reported above thresholds, so that -early can stop counting
+	// a combination that cannot reach them (one pass per order, SNPs are counted in full)
+	bool Prunes(uint32 o)
+	{
+		return early && o > 0 && !fused && (printP[o] || printIG[o]) && (!computeIG[o] || printIG[o])
+			&& !saveP[o] && !bestIG && !UsesMetrics(o) && !sketch;
+	}
+
+	// the run enumerates the SNPs in its own order (-targets, -annot or -resume) instead of the dataset order
+	bool OwnOrder()
+	{
+		return strlen(targets) || strlen(annot) || strlen(resume);
+	}
+
+	// the run saves its purities in a table of its own: in its own order, or of more samples than the dataset (-counts)
+	bool OwnPurity()
+	{
+		return OwnOrder() || strlen(counts);
+	}
 
 	ARGS()
 	{
 		memset(this, 0, sizeof(ARGS));
 		numThreads = 1;
 		order = 1;
+		bestK = 1;
 	}
 
 	~ARGS()
@@ -116,10 +339,49 @@ struct ARGS
 		printf(" -o		Output prefix\n");
 
 		printf(" -sort		Sort output files by Purity and Information-Gained\n");
+
+		printf(" -gz		gzip compress the Purity and Information-Gained files (.csv.gz)\n");
 		
 		printf(" -t		number of threads\n");
 
-		printf(" -bestIG	find the best interactions for each SNP (will disregards below options)\n");
+		printf(" -fused		compute every requested order in one traversal instead of one pass per order\n");
+		printf(" -early		count the samples of a combination in blocks and stop once it cannot reach the -pN or -igN threshold\n");
+		printf("		* only for orders 2 to 4 reported above thresholds, without -fused, -bestIG, -sketch, metrics or saved purities\n");
+		printf(" -timeBudget [s]	stop after s seconds and write the results so far and the fraction of combinations covered (coverage.csv)\n");
+		printf("		* SIGINT or SIGTERM also stops the run with the results so far, a second one kills it\n");
+		printf(" -sparse [maf]	count the combinations that end with a SNP of alternate allele frequency below maf\n");
+		printf("		from the samples that carry it, instead of from every sample\n");
+
+		printf(" -split [mode]	share the combinations of an order between the threads by their first SNP (snps), by their samples\n");
+		printf("		(samples), or by samples when the first SNPs leave the threads unbalanced (auto, default)\n");
+		printf(" -pin [policy]	pin threads to cpus: compact, cores or scatter (Linux only)\n");
+		printf(" -numa		replicate genotype data on each NUMA node (implies -pin scatter)\n");
+		printf(" -hugePages [mode]	back genotype data with huge pages: thp or explicit (Linux only)\n");
+		printf(" -collapse	enumerate one SNP of each set with identical genotypes, reported under every name, and drop monomorphic SNPs\n");
+		printf(" -model [model]	recode the genotypes when loading: additive (default), dominant (0 vs 1 or 2) or recessive (0 or 1 vs 2)\n");
+		printf("		* dominant and recessive count one bit per sample, with 2, 4, 8 or 16 cells for orders 1 to 4\n");
+
+		printf(" -targets [file]	only combinations including one of the SNPs named in file (one per line)\n");
+		printf("\t\t* a combination lists its targets first, in the order of file, then its other SNPs in the dataset order,\n");
+		printf("\t\t  and the bestIG rows start with the targets in the same way\n");
+		printf(" -annot [file]	SNP annotations, one SNP per line: name,chromosome,position[,group]\n");
+		printf(" -maxDist [bp]	only combinations of SNPs on one chromosome within bp of each other (needs -annot)\n");
+		printf(" -cis		only combinations of SNPs on the same chromosome (needs -annot)\n");
+		printf(" -trans		only combinations of SNPs on different chromosomes (needs -annot)\n");
+		printf(" -sameGroup	only combinations of SNPs in the same group (needs -annot)\n");
+		printf(" -crossGroup	only combinations of SNPs in different groups (needs -annot)\n");
+
+		printf(" -cache [dir]	keep the saved purities in dir and reuse them in later runs on the same dataset\n");
+		printf(" -saveState [file]	save the SNPs and bestIG results of the run to file (needs -bestIG)\n");
+		printf(" -resume [file]	add SNPs to the bestIG results saved by -saveState, only combinations with a new SNP are computed\n");
+		printf(" -counts [file]	add the samples of the dataset to the SNP and pair genotype counts in file, created if missing,\n");
+		printf("		and compute the purity and IG of SNPs and pairs from all the samples counted so far\n");
+
+		printf(" -plan		predict memory and run time of the other options without running them\n");
+		printf(" -sketch	write the quantiles and histogram of the purity and IG of every order computed (sketch.csv, histogram.csv)\n");
+
+		printf(" -bestIG [K]	find the best interactions for each SNP (will disregards below options)\n");
+		printf("		* K best of each order (default 1), K > 1 writes K rows per SNP with a RANK column\n");
 
 		printf(" -p1 [thr]	Compute purity for 1-SNP (SNP).\n");
 		printf(" -p2 [thr]	Compute purity for 2-SNP (Pair).\n");
@@ -131,6 +393,11 @@ struct ARGS
 		printf(" -ig3 [thr]	Compute Information-Gained (IG) for 3-SNP (Triplet).\n");
 		printf(" -ig4 [thr]	Compute Information-Gained (IG) for 4-SNP (Quadlet).\n");
 
+		printf(" -p2:mi [thr]	Compute another metric: mi (mutual information), chi2 (chi-square) or or (largest |log odds ratio|),\n");
+		printf("		for any order, from the same contingency tables as the purity.\n");
+		printf(" -ig2:mi [thr]	Compute the gain of a metric: its value minus the largest of its sub-combinations.\n");
+		printf(" -bestIG:mi	find the best interactions for each SNP by the gain of a metric (bestIG.MI.csv).\n");
+
 		printf("* thr is threshold and is optional. If you dont pass thr it computes the metric but it does not report anything (performance testing).\n");
 		printf("* 0<thr<1.\n");
 		printf("* if you want all interactions set thr to 0.\n");
@@ -142,10 +409,10 @@ struct ARGS
 		return;
 	}
 
-	void Parse(int argc, char* argv[])
+	// a session loads the input once (needOutput false) and its runs only name the output (needInput false)
+	void Parse(int argc, char* argv[], bool needInput = true, bool needOutput = true)
 	{
 		double d = -1;
-		uint32 o = 0;
 		char str[100];
 		bool next = false;
 
@@ -153,6 +420,58 @@ struct ARGS
 		{
 			next = false;
 
+			// check if a metric flag is passed for any order: -pN:metric, -igN:metric or -bestIG:metric
+			for (uint32 k = 0; k < NUM_METRIC && !next; k++)
+			{
+				sprintf(str, "-bestIG:%s", metricFlag[k]);
+				if (!strcmp(argv[i], str))
+				{
+					bestM[k] = true;
+					next = true;
+				}
+				for (uint32 o = 0; o < MAX_ORDER && !next; o++)
+				{
+					bool value = false;
+					bool gain = false;
+					sprintf(str, "-p%u:%s", o + 1, metricFlag[k]);
+					value = !strcmp(argv[i], str);
+					sprintf(str, "-ig%u:%s", o + 1, metricFlag[k]);
+					gain = !strcmp(argv[i], str);
+					if (!value && !gain)
+						continue;
+
+					// the gain needs the metric of the previous order
+					computeP[o] = computeM[k][o] = true;
+					if (gain)
+					{
+						computeMG[k][o] = true;
+						if (o > 0)
+							computeP[o - 1] = computeM[k][o - 1] = saveM[k][o - 1] = true;
+					}
+
+					// check if there is any threashold argument to this option
+					if ((i + 1) != argc && argv[i + 1][0] != '-')
+					{
+						d = atof(argv[i + 1]);
+						if ((d == 0) && (argv[i + 1][0] != '0'))
+							PrintHelp(argv[0]);
+						if (gain)
+						{
+							mg[k][o] = d;
+							printMG[k][o] = true;
+						}
+						else
+						{
+							m[k][o] = d;
+							printM[k][o] = true;
+						}
+						i++;
+					}
+					next = true;
+				}
+			}
+			if (next) continue;
+
 			// check if purity flag is passed for any order
 			for (uint32 o = 0; o < MAX_ORDER; o++)
 			{
@@ -260,1325 +579,6243 @@ struct ARGS
 				continue;
 			}
 
-			// read bestIG flag
-			if (!strcmp(argv[i], "-bestIG"))
+			// read thread pinning policy
+			if (!strcmp(argv[i], "-pin"))
 			{
-				bestIG = true;
+				if ((i + 1) == argc)
+					PrintHelp(argv[0]);
+
+				if (!strcmp(argv[i + 1], "compact"))
+					pinPolicy = PIN_COMPACT;
+				else if (!strcmp(argv[i + 1], "cores"))
+					pinPolicy = PIN_CORES;
+				else if (!strcmp(argv[i + 1], "scatter"))
+					pinPolicy = PIN_SCATTER;
+				else
+					PrintHelp(argv[0]);
+				i++;
 				continue;
 			}
 
-			// read bestIG flag
-			if (!strcmp(argv[i], "-sort"))
+			// read genotype model
+			if (!strcmp(argv[i], "-model"))
 			{
-				sort = true;
+				if ((i + 1) == argc)
+					PrintHelp(argv[0]);
+
+				if (!strcmp(argv[i + 1], "additive"))
+					model = MODEL_ADDITIVE;
+				else if (!strcmp(argv[i + 1], "dominant"))
+					model = MODEL_DOMINANT;
+				else if (!strcmp(argv[i + 1], "recessive"))
+					model = MODEL_RECESSIVE;
+				else
+					PrintHelp(argv[0]);
+				i++;
 				continue;
 			}
 
-			printf("\n***ERR*** invalid option %s\n", argv[i]);
-			PrintHelp(argv[0]);
-		}
+			// read thread split mode
+			if (!strcmp(argv[i], "-split"))
+			{
+				if ((i + 1) == argc)
+					PrintHelp(argv[0]);
 
-		// check arguments
-		if (strlen(input) == 0 || strlen(output) == 0)
-			PrintHelp(argv[0]);
+				if (!strcmp(argv[i + 1], "auto"))
+					split = SPLIT_AUTO;
+				else if (!strcmp(argv[i + 1], "snps"))
+					split = SPLIT_SNPS;
+				else if (!strcmp(argv[i + 1], "samples"))
+					split = SPLIT_SAMPLES;
+				else
+					PrintHelp(argv[0]);
+				i++;
+				continue;
+			}
 
-		// apply bestIG
-		if(bestIG)
-		for (uint32 o = 0; o < MAX_ORDER; o++)
-		{
-			computeP[o] = saveP[o] = computeIG[o] = true;
-			printP[o] = printIG[o] = false;
-		}
+			// read NUMA replication flag
+			if (!strcmp(argv[i], "-numa"))
+			{
+				numa = true;
+				continue;
+			}
 
-		if (computeP[0]) order = 1;
-		if (computeP[1]) order = 2;
-		if (computeP[2]) order = 3;
-		if (computeP[3]) order = 4;
-	}
+			// read huge page mode
+			if (!strcmp(argv[i], "-hugePages"))
+			{
+				if ((i + 1) == argc)
+					PrintHelp(argv[0]);
 
-	void Print()
-	{
-		printf("\n -i		%s", input);
-		printf("\n -o		%s", output);
-		printf("\n -t		%u", numThreads);
-		printf("\n order		%u", order);
-		printf("\n bestIG		%s", bestIG ? "true" : "false");
-		printf("\n sort			%s", sort ? "true" : "false");
-	
-		for (uint32 o = 0; o < MAX_ORDER; o++)
-		{
-			printf("\n -p%u		%f", o, p[o]);
-			printf("\n -ig%u		%f", o, ig[o]);
-			printf("\n computeP[%u]	%s", o, computeP[o] ? "true" : "false");
-			printf("\n printP[%u]	%s", o, printP[o] ? "true" : "false");
-			printf("\n saveP[%u]	%s", o, saveP[o] ? "true" : "false");
-			printf("\n computeIG[%u]	%s", o, computeIG[o] ? "true" : "false");
-			printf("\n printIG[%u]	%s", o, printIG[o]?"true":"false");
-		}
-	}
-};
+				if (!strcmp(argv[i + 1], "thp"))
+					hugePages = PAGE_TRANSPARENT;
+				else if (!strcmp(argv[i + 1], "explicit"))
+					hugePages = PAGE_EXPLICIT;
+				else
+					PrintHelp(argv[0]);
+				i++;
+				continue;
+			}
 
-void AllocatePurity(varIdx n, ARGS args)
-{
-	if (args.saveP[0])
-	{
-		SnpPurity = new double[n];
-		NULL_CHECK(SnpPurity);
-	}
+			// read collapse flag
+			if (!strcmp(argv[i], "-collapse"))
+			{
+				collapse = true;
+				continue;
+			}
 
-	if (args.saveP[1])
-	{
-		PairPurity = new double *[n];
-		NULL_CHECK(PairPurity);
-		for (varIdx i = 0; i < n; i++)
-		{
-			PairPurity[i] = new double[n];
-			NULL_CHECK(PairPurity[i]);
-		}
-	}
+			// read targets file name
+			if (!strcmp(argv[i], "-targets"))
+			{
+				if ((i + 1) == argc)
+					PrintHelp(argv[0]);
 
-	if (args.saveP[2])
-	{
-		tripletPurity = new double **[n];
-		NULL_CHECK(tripletPurity);
-		
-		for (varIdx i = 0; i < n; i++)
-		{
-			tripletPurity[i] = new double *[n];
-			NULL_CHECK(tripletPurity[i]);
+				if (argv[i + 1][0] != '-')
+					strcpy(targets, argv[i+1]);
+				else
+					PrintHelp(argv[0]);
+				i++;
+				continue;
+			}
 
-			for (varIdx j = 0; j < n; j++)
+			// read purity cache directory
+			if (!strcmp(argv[i], "-cache"))
 			{
-				tripletPurity[i][j] = new double[n];
-				NULL_CHECK(tripletPurity[i][j]);
-			}
+				if ((i + 1) == argc)
+					PrintHelp(argv[0]);
 
-		}
-	}
-}
+				if (argv[i + 1][0] != '-')
+					strcpy(cache, argv[i+1]);
+				else
+					PrintHelp(argv[0]);
+				i++;
+				continue;
+			}
 
-void FreePurity(varIdx n, ARGS args)
-{
-	if (args.saveP[0])
-	{
-		delete[] SnpPurity;
-	}
+			// read annotation file name
+			if (!strcmp(argv[i], "-annot"))
+			{
+				if ((i + 1) == argc)
+					PrintHelp(argv[0]);
 
-	if (args.saveP[1])
-	{
-		for (varIdx i = 0; i < n; i++)
-		{
-			delete[] PairPurity[i];
-		}
-		delete[] PairPurity;
-	}
+				if (argv[i + 1][0] != '-')
+					strcpy(annot, argv[i+1]);
+				else
+					PrintHelp(argv[0]);
+				i++;
+				continue;
+			}
 
-	if (args.saveP[2])
-	{
-		for (varIdx i = 0; i < n; i++)
-		{
-			for (varIdx j = 0; j < n; j++)
+			// read largest distance
+			if (!strcmp(argv[i], "-maxDist"))
 			{
-				delete[] tripletPurity[i][j];
+				if ((i + 1) == argc)
+					PrintHelp(argv[0]);
+
+				char *end;
+				maxDist = strtoull(argv[i + 1], &end, 10);
+				if (*end || !maxDist)
+					PrintHelp(argv[0]);
+				i++;
+				continue;
 			}
-			delete[] tripletPurity[i];
-		}
-		delete[] tripletPurity;
-	}
-}
 
-struct InformationGained
-{
-public:
-	double purity[4];
-	double ig[4];
-	varIdx pair[2];
-	varIdx triplet[3];
-	varIdx quadlet[4];
+			// read chromosome and group constraints
+			if (!strcmp(argv[i], "-cis"))
+			{
+				cis = true;
+				continue;
+			}
+			if (!strcmp(argv[i], "-trans"))
+			{
+				trans = true;
+				continue;
+			}
+			if (!strcmp(argv[i], "-sameGroup"))
+			{
+				sameGroup = true;
+				continue;
+			}
+			if (!strcmp(argv[i], "-crossGroup"))
+			{
+				crossGroup = true;
+				continue;
+			}
 
-	void toCSV(FILE *csv, varIdx id, char **names)
-	{
-		fprintf(csv, "%s,", names[id]);
-		fprintf(csv, "%f,%f,%f,%f,", purity[0], purity[1], purity[2], purity[3]);
-		fprintf(csv, "%f,%f,%f,%f,", ig[0], ig[1], ig[2], ig[3]);
-		
-		if (id == pair[0])
-			fprintf(csv, "%s,", names[pair[1]]);
-		else
-			fprintf(csv, "%s,", names[pair[0]]);
+			// read plan flag
+			if (!strcmp(argv[i], "-plan"))
+			{
+				plan = true;
+				continue;
+			}
 
-		if (id == triplet[0])
-			fprintf(csv, "%s,%s,", names[triplet[1]], names[triplet[2]]);
-		else if (id == triplet[1])
-			fprintf(csv, "%s,%s,", names[triplet[0]], names[triplet[2]]);
-		else
-			fprintf(csv, "%s,%s,", names[triplet[0]], names[triplet[1]]);
-
-		if (id == quadlet[0])
-			fprintf(csv, "%s,%s,%s\n", names[quadlet[1]], names[quadlet[2]], names[quadlet[3]]);
-		else if (id == quadlet[1])
-			fprintf(csv, "%s,%s,%s\n", names[quadlet[0]], names[quadlet[2]], names[quadlet[3]]);
-		else if (id == quadlet[2])
-			fprintf(csv, "%s,%s,%s\n", names[quadlet[0]], names[quadlet[1]], names[quadlet[3]]);
-		else
-			fprintf(csv, "%s,%s,%s\n", names[quadlet[0]], names[quadlet[1]], names[quadlet[2]]);
-	}
+			// read bestIG flag
+			if (!strcmp(argv[i], "-bestIG"))
+			{
+				bestIG = true;
 
-	void Max(const InformationGained &o)
-	{
-		if (o.ig[0] > ig[0])
-		{
-			ig[0] = o.ig[0];
-			purity[0] = o.purity[0];
-		}
+				// optional number of combinations kept
+				if ((i + 1) != argc && argv[i + 1][0] != '-')
+				{
+					bestK = atoi(argv[i + 1]);
+					if (bestK == 0)
+						PrintHelp(argv[0]);
+					i++;
+				}
+				continue;
+			}
 
-		if (o.ig[1] > ig[1])
-		{
-			ig[1] = o.ig[1];
-			purity[1] = o.purity[1];
-			pair[0] = o.pair[0];
-			pair[1] = o.pair[1];
-		}
+			// read bestIG flag
+			if (!strcmp(argv[i], "-sort"))
+			{
+				sort = true;
+				continue;
+			}
 
-		if (o.ig[2] > ig[2])
-		{
-			ig[2] = o.ig[2];
-			purity[2] = o.purity[2];
-			triplet[0] = o.triplet[0];
-			triplet[1] = o.triplet[1];
-			triplet[2] = o.triplet[2];
-		}
+			// read compression flag
+			if (!strcmp(argv[i], "-gz"))
+			{
+				gz = true;
+				continue;
+			}
 
-		if (o.ig[3] > ig[3])
-		{
-			ig[3] = o.ig[3];
-			purity[3] = o.purity[3];
-			quadlet[0] = o.quadlet[0];
-			quadlet[1] = o.quadlet[1];
-			quadlet[2] = o.quadlet[2];
-			quadlet[3] = o.quadlet[3];
-		}
-	}
-};
+			// read fused traversal flag
+			if (!strcmp(argv[i], "-fused"))
+			{
+				fused = true;
+				continue;
+			}
 
-class Result
-{
-public:
-	varIdx numVariable;
-	InformationGained *res;
+			// read sketch flag
+			if (!strcmp(argv[i], "-sketch"))
+			{
+				sketch = true;
+				continue;
+			}
 
-	~Result()
-	{
-		delete[] res;
-	}
+			// read early termination flag
+			if (!strcmp(argv[i], "-early"))
+			{
+				early = true;
+				continue;
+			}
 
-	void toCSV(char *fn, char **names)
-	{
-		FILE *csv = fopen(fn, "w");
-		NULL_CHECK(csv);
+			// read state files
+			if (!strcmp(argv[i], "-resume") || !strcmp(argv[i], "-saveState") || !strcmp(argv[i], "-counts"))
+			{
+				if ((i + 1) == argc)
+					PrintHelp(argv[0]);
+
+				if (argv[i + 1][0] != '-')
+					strcpy(!strcmp(argv[i], "-resume") ? resume : (!strcmp(argv[i], "-counts") ? counts : saveState), argv[i + 1]);
+				else
+					PrintHelp(argv[0]);
+				i++;
+				continue;
+			}
 
-		fprintf(csv, "SNP,SNP_P,PAIR_P,TRIPLET_P,QUADLET_P,SNP_IG,PAIR_IG,TRIPLET_IG,QUADLET_IG,PAIR,TRIPLET_1,TRIPLET_2,QUADLET_1,QUADLET_2,QUADLET_3\n");
+			// read time budget
+			if (!strcmp(argv[i], "-timeBudget"))
+			{
+				if ((i + 1) == argc)
+					PrintHelp(argv[0]);
 
-		for (varIdx i = 0; i < numVariable; i++)
-			res[i].toCSV(csv, i, names);
+				char *end;
+				timeBudget = strtod(argv[i + 1], &end);
+				if (*end || !(timeBudget > 0))
+					PrintHelp(argv[0]);
+				i++;
+				continue;
+			}
 
-		fclose(csv);
-	}
+			// read rare SNP threshold
+			if (!strcmp(argv[i], "-sparse"))
+			{
+				if ((i + 1) == argc)
+					PrintHelp(argv[0]);
 
-	void Init(varIdx nv)
-	{
-		numVariable = nv;
-		res = new InformationGained[numVariable];
-		NULL_CHECK(res);
-		memset(res, 0, numVariable * sizeof(InformationGained));
-	}
+				char *end;
+				sparse = strtod(argv[i + 1], &end);
+				if (*end || !(sparse > 0) || sparse > 1)
+					PrintHelp(argv[0]);
+				i++;
+				continue;
+			}
 
-	void Max(const Result &o)
-	{
-		for (varIdx i = 0; i < numVariable; i++)
+			printf("\n***ERR*** invalid option %s\n", argv[i]);
+			PrintHelp(argv[0]);
+		}
+
+		// check arguments
+		if ((needInput && strlen(input) == 0) || (needOutput && strlen(output) == 0))
+			PrintHelp(argv[0]);
+
+		// the constraints must be met by sorting the SNPs into contiguous windows and blocks
+		if ((maxDist || cis || trans || sameGroup || crossGroup) && !strlen(annot))
+		{
+			printf("\n***ERR*** -maxDist, -cis, -trans, -sameGroup and -crossGroup need -annot\n");
+			PrintHelp(argv[0]);
+		}
+		if (((maxDist || cis) && trans) || (sameGroup && crossGroup) || (maxDist && crossGroup) || (trans && crossGroup))
 		{
-			res[i].Max(o.res[i]);
+			printf("\n***ERR*** conflicting constraints\n");
+			PrintHelp(argv[0]);
+		}
+		if (strlen(annot) && strlen(targets))
+		{
+			printf("\n***ERR*** -annot and -targets cannot be used together\n");
+			PrintHelp(argv[0]);
+		}
+		if (strlen(annot) && collapse)
+		{
+			printf("\n***ERR*** -annot and -collapse cannot be used together (the SNPs of a set have their own positions)\n");
+			PrintHelp(argv[0]);
 		}
-	}
 
-	void Max_1(double ig, double purity, varIdx *idx)
-	{
-		if (ig > res[idx[0]].ig[0])
+		// a state holds the bestIG results of every combination of the SNPs, in the dataset order
+		if ((strlen(resume) || strlen(saveState)) && (!bestIG || strlen(targets) || strlen(annot) || collapse))
+		{
+			printf("\n***ERR*** -resume and -saveState need -bestIG, without -targets, -annot or -collapse\n");
+			PrintHelp(argv[0]);
+		}
+		bool bestMetric = false;
+		for (uint32 k = 0; k < NUM_METRIC; k++)
+			bestMetric = bestMetric || bestM[k];
+		if (strlen(resume) && (fused || sketch || bestMetric))
 		{
-			res[idx[0]].ig[0] = ig;
-			res[idx[0]].purity[0] = purity;
+			printf("\n***ERR*** -resume only adds to the bestIG results, without -fused, -sketch or the bestIG of other metrics\n");
+			PrintHelp(argv[0]);
 		}
-	}
 
-	void Max_2(double ig, double purity, varIdx *idx)
-	{
-		InformationGained *r;
-		for (uint32 i = 0; i < 2; i++)
+		// apply bestIG
+		if(bestIG)
+		for (uint32 o = 0; o < MAX_ORDER; o++)
 		{
-			r = &res[idx[i]];
-			if (ig > r->ig[1])
+			computeP[o] = saveP[o] = computeIG[o] = true;
+			printP[o] = printIG[o] = false;
+		}
+
+		// apply the bestIG of other metrics, any bestIG disregards the thresholds
+		bool best = bestIG;
+		for (uint32 k = 0; k < NUM_METRIC; k++)
+			best = best || bestM[k];
+		for (uint32 o = 0; o < MAX_ORDER && best; o++)
+		{
+			computeP[o] = true;
+			printP[o] = printIG[o] = false;
+			for (uint32 k = 0; k < NUM_METRIC; k++)
 			{
-				r->ig[1] = ig;
-				r->purity[1] = purity;
-				r->pair[0] = idx[0];
-				r->pair[1] = idx[1];
+				printM[k][o] = printMG[k][o] = false;
+				if (bestM[k])
+					computeM[k][o] = saveM[k][o] = computeMG[k][o] = true;
 			}
 		}
-	}
 
-	void Max_3(double ig, double purity, varIdx *idx)
-	{
-		InformationGained *r;
-		for (uint32 i = 0; i < 3; i++)
+		metrics = false;
+		for (uint32 o = 0; o < MAX_ORDER; o++)
+			metrics = metrics || UsesMetrics(o);
+
+		// -counts keeps the SNPs and pairs only, and counts every one of them in dataset order in each run
+		if (strlen(counts))
 		{
-			r = &res[idx[i]];
-			if (ig > r->ig[2])
+			if (strlen(targets) || strlen(annot) || collapse || fused || early || metrics || strlen(resume) || strlen(saveState))
+			{
+				printf("\n***ERR*** -counts cannot be used with -targets, -annot, -collapse, -fused, -early, metrics, -resume or -saveState\n");
+				PrintHelp(argv[0]);
+			}
+			for (uint32 o = 2; o < MAX_ORDER; o++)
 			{
-				r->ig[2] = ig;
-				r->purity[2] = purity;
-				r->triplet[0] = idx[0];
-				r->triplet[1] = idx[1];
-				r->triplet[2] = idx[2];
+				if (computeP[o] && !bestIG)
+				{
+					printf("\n***ERR*** -counts only computes SNPs and pairs\n");
+					PrintHelp(argv[0]);
+				}
+				computeP[o] = saveP[o] = computeIG[o] = printP[o] = printIG[o] = false;
 			}
+			saveP[1] = false;
+			computeP[0] = computeP[1] = true;
 		}
+
+		// replication is only useful if threads stay on their node
+		if (numa && pinPolicy == PIN_NONE)
+			pinPolicy = PIN_SCATTER;
+
+		if (computeP[0]) order = 1;
+		if (computeP[1]) order = 2;
+		if (computeP[2]) order = 3;
+		if (computeP[3]) order = 4;
 	}
 
-	void Max_4(double ig, double purity, varIdx *idx)
+	void Print()
 	{
-		InformationGained *r;
-		for (uint32 i = 0; i < 4; i++)
+		printf("\n -i		%s", input);
+		printf("\n -o		%s", output);
+		printf("\n -t		%u", numThreads);
+		printf("\n order		%u", order);
+		printf("\n bestIG		%s", bestIG ? "true" : "false");
+		printf("\n bestK		%u", bestK);
+		printf("\n sort			%s", sort ? "true" : "false");
+		printf("\n gz		%s", gz ? "true" : "false");
+		printf("\n pin		%u", pinPolicy);
+		printf("\n split		%u", split);
+		printf("\n numa		%s", numa ? "true" : "false");
+		printf("\n hugePages	%u", hugePages);
+		printf("\n collapse	%s", collapse ? "true" : "false");
+		printf("\n model		%u", model);
+		printf("\n fused	%s", fused ? "true" : "false");
+		printf("\n sketch	%s", sketch ? "true" : "false");
+		printf("\n early		%s", early ? "true" : "false");
+		printf("\n timeBudget	%f", timeBudget);
+		printf("\n sparse		%f", sparse);
+		printf("\n plan		%s", plan ? "true" : "false");
+		printf("\n -targets	%s", targets);
+		printf("\n -annot		%s", annot);
+		printf("\n -cache		%s", cache);
+		printf("\n -resume	%s", resume);
+		printf("\n -saveState	%s", saveState);
+		printf("\n -counts	%s", counts);
+		printf("\n -maxDist	%llu", (unsigned long long)maxDist);
+		printf("\n cis		%s", cis ? "true" : "false");
+		printf("\n trans		%s", trans ? "true" : "false");
+		printf("\n sameGroup	%s", sameGroup ? "true" : "false");
+		printf("\n crossGroup	%s", crossGroup ? "true" : "false");
+	
+		for (uint32 o = 0; o < MAX_ORDER; o++)
 		{
-			r = &res[idx[i]];
-			if (ig > r->ig[3])
+			printf("\n -p%u		%f", o, p[o]);
+			printf("\n -ig%u		%f", o, ig[o]);
+			printf("\n computeP[%u]	%s", o, computeP[o] ? "true" : "false");
+			printf("\n printP[%u]	%s", o, printP[o] ? "true" : "false");
+			printf("\n saveP[%u]	%s", o, saveP[o] ? "true" : "false");
+			printf("\n computeIG[%u]	%s", o, computeIG[o] ? "true" : "false");
+			printf("\n printIG[%u]	%s", o, printIG[o]?"true":"false");
+			for (uint32 k = 0; k < NUM_METRIC; k++)
 			{
-				r->ig[3] = ig;
-				r->purity[3] = purity;
-				r->quadlet[0] = idx[0];
-				r->quadlet[1] = idx[1];
-				r->quadlet[2] = idx[2];
-				r->quadlet[3] = idx[3];
+				if (!computeM[k][o])
+					continue;
+				printf("\n -p%u:%s	%f (%s)", o, metricFlag[k], m[k][o], printM[k][o] ? "print" : "compute");
+				printf("\n -ig%u:%s	%f (%s)", o, metricFlag[k], mg[k][o], printMG[k][o] ? "print" : (computeMG[k][o] ? "compute" : "no"));
 			}
 		}
 	}
+};
 
+// Header of a purity cache file (-cache), followed by the block of the order
+struct PurityCacheHeader
+{
+	char magic[8];      // "BITEPIPC"
+	uint64 key;         // Dataset::Hash of the genotypes and labels
+	uint64 numVariable;
+	uint64 order;       // 0 for SNPs, 1 for pairs, 2 for triplets
+	uint64 count;       // number of purities that follow
 };
 
-class Dataset
+// Purity of SNPs, pairs and triplets saved to compute the IG of the next order.
+// A session keeps it between runs, so a complete order is never computed twice.
+// A -targets run only saves the pairs and triplets that start with a target (numRow first indices).
+// Each order is one block of rows * n^order purities, indexed through row pointers, so that a
+// complete order can be saved to a cache file and mapped back by a later process (-cache).
+class PurityTable
 {
-	// contigency table index translation
-	// note that 3 or 0b11 is not a valid genotype and should not be considered in Gini Computation.
-	uint64 CaseIndex(varIdx v, sampleIdx s) { return ((v * numByteCase) + s); }	// get the byte index of sample in data
-	uint64 CtrlIndex(varIdx v, sampleIdx s) { return ((v * numByteCtrl) + s); }	// get the byte index of sample in data
+	// point the rows of an order into its block
+	void Index(uint32 o)
+	{
+		varIdx n = numVariable;
+		if (o == 0)
+			SnpPurity = block[0];
+
+		if (o == 1)
+		{
+			PairPurity = new double *[numRow];
+			NULL_CHECK(PairPurity);
+			for (varIdx i = 0; i < numRow; i++)
+				PairPurity[i] = block[1] + (uint64)i * n;
+		}
+
+		if (o == 2)
+		{
+			tripletPurity = new double **[numRow];
+			NULL_CHECK(tripletPurity);
+			for (varIdx i = 0; i < numRow; i++)
+			{
+				tripletPurity[i] = new double *[n];
+				NULL_CHECK(tripletPurity[i]);
+				for (varIdx j = 0; j < n; j++)
+					tripletPurity[i][j] = block[2] + ((uint64)i * n + j) * n;
+			}
+		}
+	}
 
 public:
+	varIdx numVariable;
+	varIdx numRow;
+	bool allocated[MAX_ORDER - 1];
+	bool complete[MAX_ORDER - 1]; // every combination of the order has been saved
+	double *block[MAX_ORDER - 1];
+	uint64 mappedBytes[MAX_ORDER - 1]; // size of the file mapping of a block loaded from the cache, 0 if allocated
 
-	uint32 order;
+	double *SnpPurity;
+	double **PairPurity;
+	double ***tripletPurity;
 
-	uint32 *labels;
+	PurityTable()
+	{
+		memset(this, 0, sizeof(PurityTable));
+	}
 
-	sampleIdx numSample;
+	// saved purity of a combination of order o + 1
+	double Get(uint32 o, const varIdx *idx)
+	{
+		if (o == 0)
+			return SnpPurity[idx[0]];
+		if (o == 1)
+			return PairPurity[idx[0]][idx[1]];
+		return tripletPurity[idx[0]][idx[1]][idx[2]];
+	}
 
-	sampleIdx numCase;
-	sampleIdx numCtrl;
+	void Set(uint32 o, const varIdx *idx, double p)
+	{
+		if (o == 0)
+			SnpPurity[idx[0]] = p;
+		if (o == 1)
+			PairPurity[idx[0]][idx[1]] = p;
+		if (o == 2)
+			tripletPurity[idx[0]][idx[1]][idx[2]] = p;
+	}
 
-	uint32 numWordCase;// number of machine word used to store Case data (each sample is a byte)
-	uint32 numWordCtrl;// number of machine word used to store Ctrl data (each sample is a byte)
+	~PurityTable()
+	{
+		Free();
+	}
 
-	uint32 numByteCase; // numWordCase * sizeof(word)
-	uint32 numByteCtrl; // numWordCtrl * sizeof(word)
+	// number of purities in the block of an order
+	uint64 BlockSize(uint32 o)
+	{
+		if (o == 0)
+			return numVariable;
+		uint64 size = numRow;
+		for (uint32 i = 0; i < o; i++)
+			size *= numVariable;
+		return size;
+	}
 
-	uint8 *byteCase[MAX_ORDER]; // byte pointer to store genotype data and their shifted version
-	uint8 *byteCtrl[MAX_ORDER]; // byte pointer to store genotype data and their shifted version
+	// allocate the orders that are saved by args and not allocated yet
+	void Allocate(varIdx n, varIdx rows, ARGS args)
+	{
+		numVariable = n;
+		numRow = rows;
 
-	word *wordCase[MAX_ORDER]; // the wrod pointer to byteCase
-	word *wordCtrl[MAX_ORDER]; // the wrod pointer to byteCtrl
+		for (uint32 o = 0; o < MAX_ORDER - 1; o++)
+		{
+			if (!args.saveP[o] || allocated[o])
+				continue;
+			block[o] = new double[BlockSize(o)];
+			NULL_CHECK(block[o]);
+			mappedBytes[o] = 0;
+			Index(o);
+			allocated[o] = true;
+		}
+	}
 
-	uint32 numLine;
-	varIdx numVariable;
-	char **nameVariable;
+	void FreeOrder(uint32 o)
+	{
+		if (!allocated[o])
+			return;
 
-	double setPurity; // purity of the original set
+		if (o == 1)
+			delete[] PairPurity;
+		if (o == 2)
+		{
+			for (varIdx i = 0; i < numRow; i++)
+				delete[] tripletPurity[i];
+			delete[] tripletPurity;
+		}
 
-	sampleIdx *contingency_table; // should be small enough to remain in cache
+#ifdef _MSC_VER
+		delete[] block[o];
+#else
+		if (mappedBytes[o])
+			munmap((char *)block[o] - sizeof(PurityCacheHeader), mappedBytes[o]);
+		else
+			delete[] block[o];
+#endif
+		block[o] = NULL;
+		mappedBytes[o] = 0;
+		allocated[o] = complete[o] = false;
+	}
 
-	Result *results;
+	void Free()
+	{
+		for (uint32 o = 0; o < MAX_ORDER - 1; o++)
+			FreeOrder(o);
+	}
 
-	void FreeMemory(ARGS args)
+	// map a complete order saved by an earlier run of the same dataset, false if there is no valid cache file
+	bool Load(uint32 o, const char *fn, uint64 key, varIdx n)
 	{
-		delete[] labels;
+		PurityCacheHeader header;
+		FILE *f = fopen(fn, "rb");
+		if (!f)
+			return false;
+		bool valid = fread(&header, sizeof(header), 1, f) == 1;
+		fclose(f);
+		if (!valid || memcmp(header.magic, "BITEPIPC", 8) || header.key != key || header.numVariable != n || header.order != o)
+			return false;
 
-		for (uint32 i = 0; i < numVariable; i++)
-			delete[] nameVariable[i];
-		delete nameVariable;
+		FreeOrder(o);
+		numVariable = n;
+		numRow = n;
+		if (header.count != BlockSize(o))
+			return false;
+		uint64 bytes = sizeof(header) + BlockSize(o) * sizeof(double);
 
-		for (uint32 i = 0; i < order; i++)
+#ifdef _MSC_VER
+		f = fopen(fn, "rb");
+		if (!f)
+			return false;
+		block[o] = new double[BlockSize(o)];
+		NULL_CHECK(block[o]);
+		fseek(f, sizeof(header), SEEK_SET);
+		valid = fread(block[o], sizeof(double), BlockSize(o), f) == BlockSize(o);
+		fclose(f);
+		if (!valid)
 		{
-			delete[] wordCase[i];
-			delete[] wordCtrl[i];
+			delete[] block[o];
+			return false;
 		}
-		
-		if(args.bestIG)
-			delete[] results;
+#else
+		int fd = open(fn, O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) || (uint64)st.st_size != bytes)
+		{
+			close(fd);
+			return false;
+		}
+		void *map = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED)
+			return false;
+		block[o] = (double *)((char *)map + sizeof(header));
+		mappedBytes[o] = bytes;
+#endif
+		Index(o);
+		allocated[o] = complete[o] = true;
+		return true;
 	}
 
-	// Count number of line in a file to see how many variable exits.
-	uint32 LineCount(const char *fn)
+	// save a complete order for later processes, written to a temporary file first so readers never see a partial file
+	void Store(uint32 o, const char *fn, uint64 key)
 	{
-		printf("\nCounting lines in %s.", fn);
+		PurityCacheHeader header;
+		memcpy(header.magic, "BITEPIPC", 8);
+		header.key = key;
+		header.numVariable = numVariable;
+		header.order = o;
+		header.count = BlockSize(o);
+
+		char *tmp = new char[strlen(fn) + 10];
+		NULL_CHECK(tmp);
+		sprintf(tmp, "%s.tmp", fn);
+		FILE *f = fopen(tmp, "wb");
+		bool written = f && fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(block[o], sizeof(double), header.count, f) == header.count;
+		if (f && fclose(f))
+			written = false;
+		if (written && !rename(tmp, fn))
+			printf("\nSaved %u-SNP purity to %s", o + 1, fn);
+		else
+		{
+			printf("\n*** Cannot save %u-SNP purity to %s", o + 1, fn);
+			remove(tmp);
+		}
+		delete[] tmp;
+	}
+};
 
-		FILE *f;
-		uint32 lines = 0;
+// Header of a state file (-saveState), followed by the names of the SNPs (each one ending with a 0), the
+// Dataset::VariableHash of each SNP and the bestIG results, so that a later run on more SNPs can -resume
+struct StateHeader
+{
+	char magic[8];      // "BITEPIST"
+	uint64 numVariable;
+	uint64 numCase;     // samples of the dataset, their genotypes are in the hashes
+	uint64 numCtrl;
+	uint64 bestK;
+	uint64 nameBytes;   // bytes of the names
+};
 
-		f = fopen(fn, "r");
-		NULL_CHECK(f)
+// Best IG of each SNP (-bestIG). For each order above one, a min-heap of the K combinations including
+// the SNP with the highest positive IG (the worst on top), stored as flat arrays of n * K entries,
+// each entry holding its IG, its purity and the other SNPs of the combination.
+#define RESULT_STRIPES 4096 // locks shared by the SNPs of the bestIG results, a SNP uses stripe v % RESULT_STRIPES
+#define RESULT_TIE 1e-12     // relative difference under which two IGs are equal, the order of the SNPs changes the last bits
 
-			char ch;
-		for (ch = getc(f); ch != EOF; ch = getc(f)) if (ch == '\n') lines = lines + 1;
+// The best interactions of each SNP (-bestIG), one store shared by every thread. The heap of a SNP is
+// guarded by the lock of its stripe, and a combination that cannot enter it is rejected without the lock.
+class Result
+{
+	uint64 Entry(varIdx v, uint32 e)
+	{
+		return (uint64)v * k + e;
+	}
 
-		fclose(f);
+	// a full heap only takes combinations with an IG of at least its floor (0 until it is full)
+	double Floor(uint32 o, varIdx v)
+	{
+#ifdef _MSC_VER
+		return *(volatile double *)&floor[o][v];
+#else
+		double f;
+		__atomic_load(&floor[o][v], &f, __ATOMIC_RELAXED);
+		return f;
+#endif
+	}
 
-		printf("\n%s has %u lines\n", fn, lines);
-		return lines;
+	void SetFloor(uint32 o, varIdx v, double f)
+	{
+#ifdef _MSC_VER
+		*(volatile double *)&floor[o][v] = f;
+#else
+		__atomic_store(&floor[o][v], &f, __ATOMIC_RELAXED);
+#endif
 	}
 
-	// This function read data from file
-	void ReadDataset(const char *fn)
+	// the o SNPs of a combination as map gives them (unchanged without a map), in increasing order
+	static void Sort(uint32 o, const varIdx *snps, const varIdx *map, varIdx *sorted)
 	{
-		printf("\nloading dataset %s", fn);
+		for (uint32 i = 0; i < o; i++)
+		{
+			varIdx x = map ? map[snps[i]] : snps[i];
+			uint32 j = i;
+			for (; j > 0 && sorted[j - 1] > x; j--)
+				sorted[j] = sorted[j - 1];
+			sorted[j] = x;
+		}
+	}
 
-		numLine = LineCount(fn);
-		nameVariable = new char*[numLine - 1];
-		NULL_CHECK(nameVariable);
+	// whether an entry ranks below a combination: a lower IG, or the same IG and later SNPs in the dataset
+	// order, so that the kept combinations do not depend on the order the threads or the run find them
+	bool Below(uint32 o, uint64 e, double g, const varIdx *others)
+	{
+		double f = ig[o][e];
+		if (fabs(f - g) > RESULT_TIE * (fabs(f) > fabs(g) ? fabs(f) : fabs(g)))
+			return f < g;
+		varIdx a[MAX_ORDER];
+		varIdx b[MAX_ORDER];
+		Sort(o, &partner[o][e * o], varMap, a);
+		Sort(o, others, varMap, b);
+		for (uint32 i = 0; i < o; i++)
+			if (a[i] != b[i])
+				return a[i] > b[i];
+		return false;
+	}
 
-		CsvParser *csvparser = CsvParser_new(fn, ",", 1);
-		CsvRow *row;
+	void Swap(uint32 o, uint64 a, uint64 b)
+	{
+		double d = ig[o][a];
+		ig[o][a] = ig[o][b];
+		ig[o][b] = d;
+		d = purity[o][a];
+		purity[o][a] = purity[o][b];
+		purity[o][b] = d;
+		for (uint32 i = 0; i < o; i++)
+		{
+			varIdx x = partner[o][a * o + i];
+			partner[o][a * o + i] = partner[o][b * o + i];
+			partner[o][b * o + i] = x;
+		}
+	}
 
-		const CsvRow *header = CsvParser_getHeader(csvparser);
-		NULL_CHECK(header);
+	// add a combination to the heap of v if it is one of the K best so far (the stripe of v is locked)
+	void Insert(uint32 o, varIdx v, double g, double p, const varIdx *others)
+	{
+		uint32 &count = numBest[o][v];
+		uint64 base = Entry(v, 0);
+		uint64 e;
+		if (count < k)
+		{
+			if (!(g > 0))
+				return;
+			e = Entry(v, count++);
+		}
+		else if (Below(o, base, g, others))
+			e = base;
+		else
+			return;
 
-		const char **headerFields = CsvParser_getFields(header);
+		ig[o][e] = g;
+		purity[o][e] = p;
+		for (uint32 i = 0; i < o; i++)
+			partner[o][e * o + i] = others[i];
 
-		numSample = CsvParser_getNumFields(header) - 1;
-		if (numSample >= pow(2, sizeof(sampleIdx) * 8))
-			ERROR("Change sampleIdx type to support number of samples exist in dataset");
+		// sift up a new entry, or down a replaced top
+		uint64 i = e - base;
+		while (i > 0 && Below(o, base + i, ig[o][base + (i - 1) / 2], &partner[o][(base + (i - 1) / 2) * o]))
+		{
+			Swap(o, base + i, base + (i - 1) / 2);
+			i = (i - 1) / 2;
+		}
+		while (true)
+		{
+			uint64 c = 2 * i + 1;
+			if (c >= count)
+				break;
+			if (c + 1 < count && Below(o, base + c + 1, ig[o][base + c], &partner[o][(base + c) * o]))
+				c++;
+			if (!Below(o, base + c, ig[o][base + i], &partner[o][(base + i) * o]))
+				break;
+			Swap(o, base + i, base + c);
+			i = c;
+		}
 
-		labels = new uint32[numSample];
-		NULL_CHECK(labels);
+		if (count == k)
+			SetFloor(o, v, ig[o][base]);
+	}
 
-		numCase = 0;
-		numCtrl = 0;
-		for (sampleIdx i = 0; i < numSample; i++)
+	// the combinations of order o and SNP v other than v
+	void Add(uint32 o, double g, double p, varIdx *idx)
+	{
+		varIdx others[MAX_ORDER];
+		for (uint32 i = 0; i <= o; i++)
 		{
-			sscanf(headerFields[i + 1], "%u", &labels[i]);
-			if (labels[i] > 1) ERROR("Class shold be 0 or 1");
-
-			if (labels[i])
-				numCase++;
-			else
-				numCtrl++;
+			uint32 n = 0;
+			for (uint32 j = 0; j <= o; j++)
+				if (j != i)
+					others[n++] = idx[j];
+
+			// the floor only rises, a combination below it is rejected without the lock
+			varIdx v = idx[i];
+			double f = Floor(o, v);
+			if (g < f - RESULT_TIE * f || !(g > 0))
+				continue;
+			pthread_mutex_t *lock = &stripes[v % RESULT_STRIPES];
+			pthread_mutex_lock(lock);
+			Insert(o, v, g, p, others);
+			pthread_mutex_unlock(lock);
 		}
+	}
 
-		// find number of word and byte per variable in Case and Ctrl
-		numWordCase = numCase / byte_in_word;
-		numWordCtrl = numCtrl / byte_in_word;
+	// entries of the heap of v from the best to the worst, equal IGs by their SNPs
+	void Rank(uint32 o, varIdx v, uint64 *rank)
+	{
+		uint64 base = Entry(v, 0);
+		for (uint32 r = 0; r < numBest[o][v]; r++)
+		{
+			uint64 e = base + r;
+			uint32 j = r;
+			for (; j > 0; j--)
+			{
+				uint64 f = rank[j - 1];
+				if (!Below(o, f, ig[o][e], &partner[o][e * o]))
+					break;
+				rank[j] = f;
+			}
+			rank[j] = e;
+		}
+	}
 
-		if (numCase % byte_in_word) numWordCase++;
-		if (numCtrl % byte_in_word) numWordCtrl++;
+	void PrintPartners(FILE *csv, uint32 o, uint64 e, bool last)
+	{
+		for (uint32 i = 0; i < o; i++)
+			fprintf(csv, "%s%s", names[partner[o][e * o + i]], (last && i + 1 == o) ? "\n" : ",");
+	}
 
-		numByteCase = numWordCase * byte_in_word;
-		numByteCtrl = numWordCtrl * byte_in_word;
+	char **names;
+	char ***aliases;
 
-		// allocate memory
-		wordCase[0] = new word[numLine * numWordCase];
-		wordCtrl[0] = new word[numLine * numWordCtrl];
+public:
+	varIdx numVariable;
+	uint32 k; // combinations kept for each SNP and order
 
-		NULL_CHECK(wordCase[0]);
-		NULL_CHECK(wordCtrl[0]);
+	double *ig[MAX_ORDER];      // [0] the IG of each SNP, [o] the heaps of order o + 1
+	double *purity[MAX_ORDER];
+	varIdx *partner[MAX_ORDER]; // o SNPs for each entry of order o + 1
+	uint32 *numBest[MAX_ORDER]; // entries in each heap
+	double *floor[MAX_ORDER];   // IG of the top of each full heap, read without the lock
+	pthread_mutex_t *stripes;
+	const varIdx *varMap; // dataset variable of each SNP of the store, for its ties (-resume), NULL for the dataset order
 
-		// convert to byte address
-		byteCase[0] = (uint8*)wordCase[0];
-		byteCtrl[0] = (uint8*)wordCtrl[0];
+	Result()
+	{
+		memset(this, 0, sizeof(Result));
+	}
 
-		numVariable = 0;
-		while ((row = CsvParser_getRow(csvparser)))
+	~Result()
+	{
+		for (uint32 o = 0; o < MAX_ORDER; o++)
 		{
-			const char **rowFields = CsvParser_getFields(row);
+			delete[] ig[o];
+			delete[] purity[o];
+			delete[] partner[o];
+			delete[] numBest[o];
+			delete[] floor[o];
+		}
+		if (!stripes)
+			return;
+		for (uint32 i = 0; i < RESULT_STRIPES; i++)
+			pthread_mutex_destroy(&stripes[i]);
+		delete[] stripes;
+	}
 
-			if (CsvParser_getNumFields(row) != (numSample + 1))
-				ERROR("Number of fields does not match the first line in the file");
+	// memory of the results, shared by the threads
+	static double Bytes(double n, uint32 k)
+	{
+		double bytes = n * 2 * sizeof(double) + RESULT_STRIPES * sizeof(pthread_mutex_t);
+		for (uint32 o = 1; o < MAX_ORDER; o++)
+			bytes += n * (sizeof(uint32) + sizeof(double) + k * (2 * sizeof(double) + o * sizeof(varIdx)));
+		return bytes;
+	}
 
-			nameVariable[numVariable] = new char[strlen(rowFields[0]) + 1];
-			strcpy(nameVariable[numVariable], rowFields[0]);
+	// with K = 1 one row per SNP, otherwise K rows per SNP with their RANK, the columns of a missing rank left empty.
+	// The value and gain columns are named after the metric, P and IG for the purity.
+	// With -collapse the rows of a SNP are repeated for the other SNPs of its set, partners are named by the first one.
+	void toCSV(char *fn, char **n, char ***a, const char *value, const char *gain)
+	{
+		names = n;
+		aliases = a;
+		FILE *csv = fopen(fn, "w");
+		NULL_CHECK(csv);
 
-			uint32 idxCase = 0;
-			uint32 idxCtrl = 0;
+		fprintf(csv, "SNP,%s", k == 1 ? "" : "RANK,");
+		fprintf(csv, "SNP_%s,PAIR_%s,TRIPLET_%s,QUADLET_%s,", value, value, value, value);
+		fprintf(csv, "SNP_%s,PAIR_%s,TRIPLET_%s,QUADLET_%s,", gain, gain, gain, gain);
+		fprintf(csv, "PAIR,TRIPLET_1,TRIPLET_2,QUADLET_1,QUADLET_2,QUADLET_3\n");
 
-			for (sampleIdx i = 0; i < numSample; i++)
+		uint64 *rank[MAX_ORDER];
+		for (uint32 o = 1; o < MAX_ORDER; o++)
+		{
+			rank[o] = new uint64[k];
+			NULL_CHECK(rank[o]);
+		}
+
+		for (varIdx v = 0; v < numVariable; v++)
+		{
+			for (uint32 o = 1; o < MAX_ORDER; o++)
+				Rank(o, v, rank[o]);
+
+			for (uint32 m = 0; m == 0 || (aliases && aliases[v] && aliases[v][m - 1]); m++)
+			for (uint32 r = 0; r < k; r++)
 			{
-				uint32 gt;
-				sscanf(rowFields[i + 1], "%u", &gt);
-				if (gt > 2) ERROR("Values shold be 0 or 1 or 2");
-				if (labels[i])
+				fprintf(csv, "%s,", m ? aliases[v][m - 1] : names[v]);
+				if (k > 1)
+					fprintf(csv, "%u,", r + 1);
+
+				// a SNP without a combination of positive IG reports the first SNP with an IG of 0, as one row per SNP always did
+				bool some[MAX_ORDER];
+				for (uint32 o = 0; o < MAX_ORDER; o++)
+					some[o] = (o == 0) ? (r == 0) : (r < numBest[o][v] || k == 1);
+
+				for (uint32 o = 0; o < MAX_ORDER; o++)
 				{
-					byteCase[0][CaseIndex(numVariable, idxCase)] = (uint8)gt;
-					idxCase++;
+					if (!some[o])
+						fprintf(csv, ",");
+					else if (o == 0)
+						fprintf(csv, "%f,", purity[0][v]);
+					else
+						fprintf(csv, "%f,", r < numBest[o][v] ? purity[o][rank[o][r]] : 0.0);
 				}
-				else
+				for (uint32 o = 0; o < MAX_ORDER; o++)
 				{
-					byteCtrl[0][CtrlIndex(numVariable, idxCtrl)] = (uint8)gt;
-					idxCtrl++;
+					if (!some[o])
+						fprintf(csv, ",");
+					else if (o == 0)
+						fprintf(csv, "%f,", ig[0][v]);
+					else
+						fprintf(csv, "%f,", r < numBest[o][v] ? ig[o][rank[o][r]] : 0.0);
+				}
+				for (uint32 o = 1; o < MAX_ORDER; o++)
+				{
+					bool last = (o == MAX_ORDER - 1);
+					if (r < numBest[o][v])
+						PrintPartners(csv, o, rank[o][r], last);
+					else
+						for (uint32 i = 0; i < o; i++)
+							fprintf(csv, "%s%s", some[o] ? names[0] : "", (last && i + 1 == o) ? "\n" : ",");
 				}
 			}
-			CsvParser_destroy_row(row);
-
-			numVariable++;
 		}
 
-		CsvParser_destroy(csvparser);
-
-		return;
+		for (uint32 o = 1; o < MAX_ORDER; o++)
+			delete[] rank[o];
+		fclose(csv);
 	}
 
-	// This function write data from file (to test ReadDataset function)
-	void WriteDataset(const char *fn)
+	void Init(varIdx nv, uint32 best)
 	{
-		printf("\nWrite dataset to %s", fn);
-
-		FILE *f = fopen(fn, "w");
-		NULL_CHECK(f);
-
-		fprintf(f, "Var\\Class");
-
-		for (uint32 i = 0; i < numSample; i++)
+		numVariable = nv;
+		k = best;
+		for (uint32 o = 0; o < MAX_ORDER; o++)
 		{
-			fprintf(f, ",%u", labels[i]);
+			uint64 entries = o ? (uint64)numVariable * k : numVariable;
+			ig[o] = new double[entries];
+			purity[o] = new double[entries];
+			NULL_CHECK(ig[o]);
+			NULL_CHECK(purity[o]);
+			memset(ig[o], 0, entries * sizeof(double));
+			memset(purity[o], 0, entries * sizeof(double));
+			if (!o)
+				continue;
+			partner[o] = new varIdx[entries * o];
+			numBest[o] = new uint32[numVariable];
+			floor[o] = new double[numVariable];
+			NULL_CHECK(partner[o]);
+			NULL_CHECK(numBest[o]);
+			NULL_CHECK(floor[o]);
+			memset(numBest[o], 0, numVariable * sizeof(uint32));
+			memset(floor[o], 0, numVariable * sizeof(double));
 		}
-		fprintf(f, "\n");
-
-		for (uint32 j = 0; j < numVariable; j++)
-		{
-			fprintf(f, "%s", nameVariable[j]);
 
-			uint32 idxCase = 0;
-			uint32 idxCtrl = 0;
+		stripes = new pthread_mutex_t[RESULT_STRIPES];
+		NULL_CHECK(stripes);
+		for (uint32 i = 0; i < RESULT_STRIPES; i++)
+			pthread_mutex_init(&stripes[i], NULL);
+	}
 
-			for (uint32 i = 0; i < numSample; i++)
+	// add the combinations of another store, whose SNP v is map[v] here, as if this store had found them
+	void Merge(Result *other, const varIdx *map)
+	{
+		for (varIdx v = 0; v < other->numVariable; v++)
+		{
+			varIdx u = map[v];
+			ig[0][u] = other->ig[0][v];
+			purity[0][u] = other->purity[0][v];
+			for (uint32 o = 1; o < MAX_ORDER; o++)
+			for (uint32 r = 0; r < other->numBest[o][v]; r++)
 			{
-				if (labels[i])
-				{
-					fprintf(f, ",%u", byteCase[0][CaseIndex(j, idxCase)]);
-					idxCase++;
-				}
-				else
-				{
-					fprintf(f, ",%u", byteCtrl[0][CtrlIndex(j, idxCtrl)]);
-					idxCtrl++;
-				}
+				// the other SNPs in increasing order, as the kernels find them
+				uint64 e = other->Entry(v, r);
+				varIdx others[MAX_ORDER];
+				Sort(o, &other->partner[o][e * o], map, others);
+				Insert(o, u, other->ig[o][e], other->purity[o][e], others);
 			}
-			fprintf(f, "\n");
 		}
-		fclose(f);
-		return;
 	}
 
-	void ComputeSetPurity()
+	// the results as saved in a state file (-saveState)
+	bool Write(FILE *f)
 	{
-		numCase = 0;
-		numCtrl = 0;
-		for (sampleIdx i = 0; i < numSample; i++)
-			if (labels[i]) numCase++; else numCtrl++;
-		setPurity = P2((double)numCase / numSample) + P2((double)numCtrl / numSample);
-		printf("\nSet Purity of the dataset is %f", setPurity);
+		uint64 entries = (uint64)numVariable * k;
+		bool written = fwrite(ig[0], sizeof(double), numVariable, f) == numVariable && fwrite(purity[0], sizeof(double), numVariable, f) == numVariable;
+		for (uint32 o = 1; o < MAX_ORDER && written; o++)
+			written = fwrite(numBest[o], sizeof(uint32), numVariable, f) == numVariable
+				&& fwrite(ig[o], sizeof(double), entries, f) == entries
+				&& fwrite(purity[o], sizeof(double), entries, f) == entries
+				&& fwrite(partner[o], sizeof(varIdx), entries * o, f) == entries * o;
+		return written;
 	}
 
-	void Shift()
+	// read the results of a state file after Init with its numVariable and k (-resume), false if it is not valid
+	bool Read(FILE *f)
 	{
-		for (uint32 d = 1; d < order; d++)
+		uint64 entries = (uint64)numVariable * k;
+		bool valid = fread(ig[0], sizeof(double), numVariable, f) == numVariable && fread(purity[0], sizeof(double), numVariable, f) == numVariable;
+		for (uint32 o = 1; o < MAX_ORDER && valid; o++)
 		{
-			// allocate memory
-			wordCase[d] = new word[numVariable * numWordCase];
-			wordCtrl[d] = new word[numVariable * numWordCtrl];
-			NULL_CHECK(wordCase[d]);
-			NULL_CHECK(wordCtrl[d]);
-			// convert to byte address
-			byteCase[d] = (uint8*)wordCase[d];
-			byteCtrl[d] = (uint8*)wordCtrl[d];
-
-			// shoft and copy
-			for (uint32 i = 0; i < (numVariable * numWordCase); i++)
-				wordCase[d][i] = wordCase[d - 1][i] << 2;
-			for (uint32 i = 0; i < (numVariable * numWordCtrl); i++)
-				wordCtrl[d][i] = wordCtrl[d - 1][i] << 2;
-
-			printf("\nShift dataset by %u bits compeleted", d * 2);
+			valid = fread(numBest[o], sizeof(uint32), numVariable, f) == numVariable
+				&& fread(ig[o], sizeof(double), entries, f) == entries
+				&& fread(purity[o], sizeof(double), entries, f) == entries
+				&& fread(partner[o], sizeof(varIdx), entries * o, f) == entries * o;
+			for (varIdx v = 0; v < numVariable && valid; v++)
+			{
+				valid = numBest[o][v] <= k;
+				for (uint32 r = 0; r < numBest[o][v] && valid; r++)
+					for (uint32 i = 0; i < o; i++)
+						valid = valid && partner[o][Entry(v, r) * o + i] < numVariable;
+				if (valid && numBest[o][v] == k)
+					floor[o][v] = ig[o][Entry(v, 0)];
+			}
 		}
+		return valid;
 	}
 
-	void Init(ARGS args)
+	// a SNP is processed by one thread only
+	void Max_1(double g, double p, varIdx *idx)
 	{
-		order = args.order;
-		if (args.bestIG)
+		if (g > ig[0][idx[0]])
 		{
-			results = new Result[args.numThreads]; // number of threads
-			for (uint32 i = 0; i < args.numThreads; i++)
-				results[i].Init(numVariable);
+			ig[0][idx[0]] = g;
+			purity[0][idx[0]] = p;
 		}
-		ComputeSetPurity();
-		Shift();
 	}
 
-	word *GetVarCase(uint32 o, varIdx vi)
+	void Max_2(double g, double p, varIdx *idx)
 	{
-		return &wordCase[o][vi*numWordCase];
+		Add(1, g, p, idx);
 	}
 
-	word *GetVarCtrl(uint32 o, varIdx vi)
+	void Max_3(double g, double p, varIdx *idx)
 	{
-		return &wordCtrl[o][vi*numWordCtrl];
+		Add(2, g, p, idx);
 	}
-};
-
-struct ThreadData
-{
-	void *epiStat; // epi class
-	uint32 id; // thread index
-};
-
-class EpiStat
-{
-public:
-	Dataset *dataset;
 
-	ARGS args;
-	uint32 threadIdx;
+	void Max_4(double g, double p, varIdx *idx)
+	{
+		Add(3, g, p, idx);
+	}
 
-	void *(*threadFunction[4]) (void *);
+	// a combination of any order
+	void Best(uint32 o, double g, double p, varIdx *idx)
+	{
+		if (o == 0)
+			Max_1(g, p, idx);
+		else
+			Add(o, g, p, idx);
+	}
+};
 
-	// These 4 items must be allocated by each thread separately
-	word *epiCaseWord[3];
-	word *epiCtrlWord[3];
+#define SKETCH_BINS 2000    // histogram bins of width 0.001 from -1 to 1, values outside go to the first or last bin
+#define SKETCH_K 256        // items of the top compactor of the quantile sketch (rank error about 1%)
+#define SKETCH_LEVELS 48    // compactors, enough for 2^48 items
+#define SKETCH_QUANTILES 11 // quantiles reported between the minimum and the maximum
 
-	sampleIdx *contingencyCase;
-	sampleIdx *contingencyCtrl;
+const double sketchQuantile[SKETCH_QUANTILES] = { 0.01, 0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.999, 0.9999 };
+const char *sketchColumn[SKETCH_QUANTILES] = { "Q01", "Q05", "Q10", "Q25", "Q50", "Q75", "Q90", "Q95", "Q99", "Q999", "Q9999" };
 
-	FILE **topPfile;
-	FILE **topIGfile;
+// An item of the quantile sketch and the number of values it stands for
+struct SketchItem
+{
+	double value;
+	uint64 weight;
+};
 
-	void OpenFiles(uint32 order)
+// The distribution of the purity or IG of one order seen by one thread (-sketch): an exact histogram
+// of fixed bins and a KLL quantile sketch. Sketches of several threads merge into one.
+class Sketch
+{
+	uint64 bins[SKETCH_BINS];
+	double *level[SKETCH_LEVELS]; // compactor h holds items of weight 2^h
+	uint32 size[SKETCH_LEVELS];
+	uint32 numLevel;
+	uint64 random; // xorshift state choosing the items kept by a compaction
+
+	// items a compactor holds before it is compacted, smaller for the lower levels
+	uint32 Capacity(uint32 h)
 	{
-		topPfile = new FILE*[args.numThreads];
-		NULL_CHECK(topPfile);
-
-		topIGfile = new FILE*[args.numThreads];
-		NULL_CHECK(topIGfile);
-
-		char* fn = new char[strlen(args.output) + 20];
-		NULL_CHECK(fn);
-		for (uint32 t = 0; t < args.numThreads; t++)
-		{
-			if (args.printP[order])
-			{
-				sprintf(fn, "%s.Purity.%u.%u.csv", args.output, order, t);
-				topPfile[t] = fopen(fn, "w");
-				NULL_CHECK(topPfile)
-			}
-			if (args.printIG[order])
-			{
-				sprintf(fn, "%s.IG.%u.%u.csv", args.output, order, t);
-				topIGfile[t] = fopen(fn, "w");
-				NULL_CHECK(topIGfile)
-			}
-		}
-		delete[]fn;
+		double c = SKETCH_K * pow(2.0 / 3.0, (double)(numLevel - h - 1));
+		return c < 2 ? 2 : (uint32)c;
 	}
 
-	void CloseFiles(uint32 order)
+	static int Compare(const void *a, const void *b)
 	{
-		for (uint32 t = 0; t < args.numThreads; t++)
-		{
-			if (args.printP[order])
-			{
-				fclose(topPfile[t]);
-			}
-			if (args.printIG[order])
-			{
-				fclose(topIGfile[t]);
-			}
-		}
+		double x = *(const double *)a;
+		double y = *(const double *)b;
+		return (x > y) - (x < y);
 	}
 
-	EpiStat()
+	void AddLevel()
 	{
-		return;
+		if (numLevel == SKETCH_LEVELS)
+			ERROR("Quantile sketch is full");
+		level[numLevel] = new double[2 * SKETCH_K + 2];
+		NULL_CHECK(level[numLevel]);
+		size[numLevel++] = 0;
 	}
 
-	~EpiStat()
+	// sort compactor h and move every other item, from a random first one, to compactor h + 1
+	void Compact(uint32 h)
 	{
-		
+		if (h + 1 == numLevel)
+			AddLevel();
+		qsort(level[h], size[h], sizeof(double), Compare);
+
+		random ^= random << 13;
+		random ^= random >> 7;
+		random ^= random << 17;
+		uint32 n = size[h] & ~1u; // an odd item stays
+		for (uint32 i = (uint32)(random & 1); i < n; i += 2)
+			level[h + 1][size[h + 1]++] = level[h][i];
+		if (size[h] & 1)
+			level[h][0] = level[h][n];
+		size[h] &= 1;
 	}
-	
-	EpiStat(EpiStat *ref)
+
+	void Insert(uint32 h, double v)
 	{
-		memcpy(this, ref, sizeof(EpiStat));
+		level[h][size[h]++] = v;
+		for (uint32 l = h; l < numLevel && size[l] >= Capacity(l); l++)
+			Compact(l);
 	}
 
-	void Init(Dataset *d, ARGS a, void *(*tf1) (void *), void *(*tf2) (void *), void *(*tf3) (void *), void *(*tf4) (void *))
+public:
+	uint64 count;
+	double min;
+	double max;
+
+	void Init(uint64 seed)
 	{
-		dataset = d;
-		args = a;
-		threadFunction[0] = tf1;
-		threadFunction[1] = tf2;
-		threadFunction[2] = tf3;
-		threadFunction[3] = tf4;
+		memset(bins, 0, sizeof(bins));
+		memset(level, 0, sizeof(level));
+		memset(size, 0, sizeof(size));
+		numLevel = 0;
+		AddLevel();
+		random = seed * 0x9e3779b97f4a7c15ULL + 1;
+		count = 0;
+		min = max = 0;
 	}
 
-	void AllocateThreadMemory()
+	void Free()
 	{
-		for (uint32 i = 0; i < MAX_ORDER-1; i++)
-		{
-			epiCaseWord[i] = new word[dataset->numWordCase];
-			epiCtrlWord[i] = new word[dataset->numWordCtrl];
+		for (uint32 h = 0; h < numLevel; h++)
+			delete[] level[h];
+		numLevel = 0;
+	}
 
-			NULL_CHECK(epiCaseWord[i]);
-			NULL_CHECK(epiCtrlWord[i]);
-		}
+	// memory of a sketch of n values
+	static double Bytes(double n)
+	{
+		double levels = n > 1 ? ceil(log(n / SKETCH_K) / log(2.0)) + 1 : 1;
+		return sizeof(Sketch) + (levels < 1 ? 1 : levels) * (2 * SKETCH_K + 2) * sizeof(double);
+	}
 
-		contingencyCase = new sampleIdx[(uint32)pow(2, MAX_ORDER * 2)];
-		contingencyCtrl = new sampleIdx[(uint32)pow(2, MAX_ORDER * 2)];
+	uint32 Bin(double v)
+	{
+		double b = floor((v + 1) * (SKETCH_BINS / 2));
+		return b < 0 ? 0 : (b >= SKETCH_BINS ? SKETCH_BINS - 1 : (uint32)b);
+	}
 
-		NULL_CHECK(contingencyCase);
-		NULL_CHECK(contingencyCtrl);
+	void Add(double v)
+	{
+		if (!count || v < min)
+			min = v;
+		if (!count || v > max)
+			max = v;
+		count++;
+		bins[Bin(v)]++;
+		Insert(0, v);
 	}
 
-	void FreeThreadMemory()
+	void Merge(Sketch &other)
 	{
-		for (uint32 i = 0; i < MAX_ORDER-1; i++)
+		if (!other.count)
+			return;
+		if (!count || other.min < min)
+			min = other.min;
+		if (!count || other.max > max)
+			max = other.max;
+		count += other.count;
+		for (uint32 b = 0; b < SKETCH_BINS; b++)
+			bins[b] += other.bins[b];
+		for (uint32 h = 0; h < other.numLevel; h++)
 		{
-			delete[] epiCaseWord[i];
-			delete[] epiCtrlWord[i];
+			while (numLevel <= h)
+				AddLevel();
+			for (uint32 i = 0; i < other.size[h]; i++)
+				Insert(h, other.level[h][i]);
 		}
-
-		delete[] contingencyCase;
-		delete[] contingencyCtrl;
 	}
 
-	void OR_1(varIdx idx)
+	// the values of the quantiles q[0..n), in increasing order, from the weighted items
+	void Quantiles(const double *q, uint32 n, double *value)
 	{
-		const uint32 OIDX = 0; // SNP
-		word *caseData = dataset->GetVarCase(OIDX, idx);
-		word *ctrlData = dataset->GetVarCtrl(OIDX, idx);
-
-		for (uint32 i = 0; i < dataset->numWordCase; i++)
+		uint32 numItem = 0;
+		for (uint32 h = 0; h < numLevel; h++)
+			numItem += size[h];
+		SketchItem *items = new SketchItem[numItem + 1];
+		NULL_CHECK(items);
+		uint64 total = 0;
+		numItem = 0;
+		for (uint32 h = 0; h < numLevel; h++)
 		{
-			epiCaseWord[OIDX][i] = caseData[i];
+			for (uint32 i = 0; i < size[h]; i++)
+			{
+				items[numItem].value = level[h][i];
+				items[numItem++].weight = 1ULL << h;
+				total += 1ULL << h;
+			}
 		}
+		qsort(items, numItem, sizeof(SketchItem), Compare); // by value, the first member
 
-		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
+		uint32 i = 0;
+		uint64 rank = 0;
+		for (uint32 k = 0; k < n; k++)
 		{
-			epiCtrlWord[OIDX][i] = ctrlData[i];
+			while (i < numItem && rank + items[i].weight <= q[k] * total)
+				rank += items[i++].weight;
+			value[k] = i < numItem ? items[i].value : max;
 		}
+		delete[] items;
 	}
 
-	void OR_2(varIdx idx)
+	// one row of the summary: count, minimum, quantiles and maximum
+	void WriteSummary(FILE *f, uint32 o, const char *measure)
 	{
-		const uint32 OIDX = 1; // Pair
-		word *caseData = dataset->GetVarCase(OIDX, idx);
-		word *ctrlData = dataset->GetVarCtrl(OIDX, idx);
-
-		for (uint32 i = 0; i < dataset->numWordCase; i++)
-		{
-			epiCaseWord[OIDX][i] = epiCaseWord[OIDX - 1][i] | caseData[i];
-		}
+		double value[SKETCH_QUANTILES];
+		Quantiles(sketchQuantile, SKETCH_QUANTILES, value);
+		fprintf(f, "%u,%s,%llu,%f", o + 1, measure, (unsigned long long)count, min);
+		for (uint32 k = 0; k < SKETCH_QUANTILES; k++)
+			fprintf(f, ",%f", value[k]);
+		fprintf(f, ",%f\n", max);
+	}
 
-		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
+	// the non-empty bins, with the number of values from the bottom of each bin up
+	void WriteHistogram(FILE *f, uint32 o, const char *measure)
+	{
+		uint64 above = 0;
+		for (uint32 b = SKETCH_BINS; b-- > 0;)
 		{
-			epiCtrlWord[OIDX][i] = epiCtrlWord[OIDX - 1][i] | ctrlData[i];
+			above += bins[b];
+			if (!bins[b])
+				continue;
+			double low = (double)b / (SKETCH_BINS / 2) - 1;
+			fprintf(f, "%u,%s,%f,%f,%llu,%llu\n", o + 1, measure, low, low + 2.0 / SKETCH_BINS, (unsigned long long)bins[b], (unsigned long long)above);
 		}
 	}
+};
 
-	void OR_3(varIdx idx)
-	{
-		const uint32 OIDX = 2; // Triplet
-		word *caseData = dataset->GetVarCase(OIDX, idx);
-		word *ctrlData = dataset->GetVarCtrl(OIDX, idx);
+// set by SIGINT or SIGTERM in the command line program, the run stops at the next work unit and keeps its results
+volatile sig_atomic_t stopSignal = 0;
 
-		for (uint32 i = 0; i < dataset->numWordCase; i++)
-		{
-			epiCaseWord[OIDX][i] = epiCaseWord[OIDX - 1][i] | caseData[i];
-		}
+void StopOnSignal(int sig)
+{
+	stopSignal = 1;
+	signal(sig, SIG_DFL); // a second signal ends the program
+}
 
-		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
+double WallClock()
+{
+#ifdef _MSC_VER
+	return (double)clock() / CLOCKS_PER_SEC;
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+// Number of combinations of k out of n
+double Combinations(double n, uint32 k)
+{
+	double c = 1;
+	for (uint32 i = 0; i < k; i++)
+		c = c * (n - i) / (i + 1);
+	return c > 0 ? c : 0;
+}
+
+// Allocate n words with the requested page backing.
+word *AllocateWords(uint64 n, uint32 pageMode)
+{
+	uint64 bytes = n * sizeof(word);
+	if (bytes == 0)
+		bytes = sizeof(word);
+#ifdef __linux__
+	if (pageMode == PAGE_EXPLICIT)
+	{
+		uint64 len = (bytes + HUGE_PAGE - 1) & ~((uint64)HUGE_PAGE - 1);
+		void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p == MAP_FAILED)
 		{
-			epiCtrlWord[OIDX][i] = epiCtrlWord[OIDX - 1][i] | ctrlData[i];
+			printf("\n*** WARNING: no explicit huge pages available, using transparent huge pages");
+			p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED)
+				ERROR("Cannot map genotype memory");
+			madvise(p, len, MADV_HUGEPAGE);
 		}
+		return (word *)p;
 	}
-
-	void OR_1x(varIdx idx)
+	if (pageMode == PAGE_TRANSPARENT)
 	{
-		const uint32 OIDX = 0; // SNPs
-		word *caseData = dataset->GetVarCase(OIDX, idx);
-		word *ctrlData = dataset->GetVarCtrl(OIDX, idx);
+		void *p = NULL;
+		if (posix_memalign(&p, HUGE_PAGE, bytes))
+			ERROR("Cannot allocate genotype memory");
+		madvise(p, bytes, MADV_HUGEPAGE);
+		return (word *)p;
+	}
+#endif
+	word *w = new word[bytes / sizeof(word)];
+	NULL_CHECK(w);
+	return w;
+}
 
-		WordByte wb;
-		for (uint32 i = 0; i < dataset->numWordCase; i++)
-		{
-			wb.w = caseData[i];
-			contingencyCase[wb.b[0]]++;
-			contingencyCase[wb.b[1]]++;
-			contingencyCase[wb.b[2]]++;
-			contingencyCase[wb.b[3]]++;
-			contingencyCase[wb.b[4]]++;
-			contingencyCase[wb.b[5]]++;
-			contingencyCase[wb.b[6]]++;
-			contingencyCase[wb.b[7]]++;
-		}
-
-		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
-		{
-			wb.w = ctrlData[i];
-			contingencyCtrl[wb.b[0]]++;
-			contingencyCtrl[wb.b[1]]++;
-			contingencyCtrl[wb.b[2]]++;
-			contingencyCtrl[wb.b[3]]++;
-			contingencyCtrl[wb.b[4]]++;
-			contingencyCtrl[wb.b[5]]++;
-			contingencyCtrl[wb.b[6]]++;
-			contingencyCtrl[wb.b[7]]++;
-		}
+void FreeWords(word *w, uint64 n, uint32 pageMode)
+{
+	uint64 bytes = n * sizeof(word);
+	if (bytes == 0)
+		bytes = sizeof(word);
+#ifdef __linux__
+	if (pageMode == PAGE_EXPLICIT)
+	{
+		munmap(w, (bytes + HUGE_PAGE - 1) & ~((uint64)HUGE_PAGE - 1));
+		return;
 	}
-
-	void OR_2x(varIdx idx)
+	if (pageMode == PAGE_TRANSPARENT)
 	{
-		const uint32 OIDX = 1; // Pair
-		word *caseData = dataset->GetVarCase(OIDX, idx);
-		word *ctrlData = dataset->GetVarCtrl(OIDX, idx);
+		free(w);
+		return;
+	}
+#endif
+	delete[] w;
+}
 
-		WordByte wb;
-		for (uint32 i = 0; i < dataset->numWordCase; i++)
-		{
-			wb.w = epiCaseWord[OIDX - 1][i] | caseData[i];
-			contingencyCase[wb.b[0]]++;
-			contingencyCase[wb.b[1]]++;
-			contingencyCase[wb.b[2]]++;
-			contingencyCase[wb.b[3]]++;
-			contingencyCase[wb.b[4]]++;
-			contingencyCase[wb.b[5]]++;
-			contingencyCase[wb.b[6]]++;
-			contingencyCase[wb.b[7]]++;
-		}
+struct CpuInfo
+{
+	int32 cpu;
+	uint32 node;
+	uint32 package;
+	uint32 core;
+	uint32 smt;  // rank of this cpu among its core's SMT siblings
+	uint32 rank; // rank of this cpu's core within its node
+};
 
-		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
-		{
-			wb.w = epiCtrlWord[OIDX - 1][i] | ctrlData[i];
-			contingencyCtrl[wb.b[0]]++;
-			contingencyCtrl[wb.b[1]]++;
-			contingencyCtrl[wb.b[2]]++;
-			contingencyCtrl[wb.b[3]]++;
-			contingencyCtrl[wb.b[4]]++;
-			contingencyCtrl[wb.b[5]]++;
-			contingencyCtrl[wb.b[6]]++;
-			contingencyCtrl[wb.b[7]]++;
-		}
+// Machine topology and the cpu/NUMA node assigned to each worker thread.
+class Placement
+{
+	bool ReadSysFile(const char *fn, char *buf, uint32 len)
+	{
+		FILE *f = fopen(fn, "r");
+		if (!f)
+			return false;
+		size_t r = fread(buf, 1, len - 1, f);
+		buf[r] = 0;
+		fclose(f);
+		return r > 0;
 	}
 
-	void OR_3x(varIdx idx)
+	uint32 ReadSysValue(const char *fmt, int32 cpu)
 	{
-		const uint32 OIDX = 2; // Triplet
-		word *caseData = dataset->GetVarCase(OIDX, idx);
-		word *ctrlData = dataset->GetVarCtrl(OIDX, idx);
-
-		WordByte wb;
-		for (uint32 i = 0; i < dataset->numWordCase; i++)
-		{
-			wb.w = epiCaseWord[OIDX - 1][i] | caseData[i];
-			contingencyCase[wb.b[0]]++;
-			contingencyCase[wb.b[1]]++;
-			contingencyCase[wb.b[2]]++;
-			contingencyCase[wb.b[3]]++;
-			contingencyCase[wb.b[4]]++;
-			contingencyCase[wb.b[5]]++;
-			contingencyCase[wb.b[6]]++;
-			contingencyCase[wb.b[7]]++;
-		}
-
-		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
-		{
-			wb.w = epiCtrlWord[OIDX - 1][i] | ctrlData[i];
-			contingencyCtrl[wb.b[0]]++;
-			contingencyCtrl[wb.b[1]]++;
-			contingencyCtrl[wb.b[2]]++;
-			contingencyCtrl[wb.b[3]]++;
-			contingencyCtrl[wb.b[4]]++;
-			contingencyCtrl[wb.b[5]]++;
-			contingencyCtrl[wb.b[6]]++;
-			contingencyCtrl[wb.b[7]]++;
-		}
+		char fn[256];
+		char buf[64];
+		sprintf(fn, fmt, cpu);
+		if (!ReadSysFile(fn, buf, sizeof(buf)))
+			return 0;
+		return (uint32)atoi(buf);
 	}
 
-	void OR_4x(varIdx idx)
+	// parse a cpulist such as "0-3,8,10-11"
+	uint32 ParseCpuList(const char *s, int32 *list, uint32 max)
 	{
-		const uint32 OIDX = 3; // Quadlet
-		word *caseData = dataset->GetVarCase(OIDX, idx);
-		word *ctrlData = dataset->GetVarCtrl(OIDX, idx);
-
-		WordByte wb;
-		for (uint32 i = 0; i < dataset->numWordCase; i++)
+		uint32 n = 0;
+		while (*s && *s != '\n')
 		{
-			wb.w = epiCaseWord[OIDX - 1][i] | caseData[i];
-			contingencyCase[wb.b[0]]++;
-			contingencyCase[wb.b[1]]++;
-			contingencyCase[wb.b[2]]++;
-			contingencyCase[wb.b[3]]++;
-			contingencyCase[wb.b[4]]++;
-			contingencyCase[wb.b[5]]++;
-			contingencyCase[wb.b[6]]++;
-			contingencyCase[wb.b[7]]++;
+			char *end;
+			int32 a = (int32)strtol(s, &end, 10);
+			int32 b = a;
+			if (end == s)
+				break;
+			s = end;
+			if (*s == '-')
+			{
+				b = (int32)strtol(s + 1, &end, 10);
+				s = end;
+			}
+			for (int32 c = a; c <= b && n < max; c++)
+				list[n++] = c;
+			if (*s == ',')
+				s++;
 		}
+		return n;
+	}
 
-		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
-		{
-			wb.w = epiCtrlWord[OIDX - 1][i] | ctrlData[i];
-			contingencyCtrl[wb.b[0]]++;
-			contingencyCtrl[wb.b[1]]++;
-			contingencyCtrl[wb.b[2]]++;
-			contingencyCtrl[wb.b[3]]++;
-			contingencyCtrl[wb.b[4]]++;
-			contingencyCtrl[wb.b[5]]++;
-			contingencyCtrl[wb.b[6]]++;
-			contingencyCtrl[wb.b[7]]++;
-		}
+	static int CompareCompact(const void *x, const void *y)
+	{
+		const CpuInfo *a = (const CpuInfo *)x;
+		const CpuInfo *b = (const CpuInfo *)y;
+		if (a->node != b->node) return a->node < b->node ? -1 : 1;
+		if (a->rank != b->rank) return a->rank < b->rank ? -1 : 1;
+		if (a->smt != b->smt) return a->smt < b->smt ? -1 : 1;
+		return a->cpu - b->cpu;
 	}
-	
-	void ResetContigencyTable_1()
+
+	static int CompareCores(const void *x, const void *y)
 	{
-		memset(contingencyCtrl, 0, 4 * sizeof(sampleIdx));
-		memset(contingencyCase, 0, 4 * sizeof(sampleIdx));
+		const CpuInfo *a = (const CpuInfo *)x;
+		const CpuInfo *b = (const CpuInfo *)y;
+		if (a->smt != b->smt) return a->smt < b->smt ? -1 : 1;
+		if (a->node != b->node) return a->node < b->node ? -1 : 1;
+		if (a->rank != b->rank) return a->rank < b->rank ? -1 : 1;
+		return a->cpu - b->cpu;
 	}
 
-	void ResetContigencyTable_2()
+	static int CompareScatter(const void *x, const void *y)
 	{
-		memset(contingencyCtrl, 0, 16 * sizeof(sampleIdx));
-		memset(contingencyCase, 0, 16 * sizeof(sampleIdx));
+		const CpuInfo *a = (const CpuInfo *)x;
+		const CpuInfo *b = (const CpuInfo *)y;
+		if (a->smt != b->smt) return a->smt < b->smt ? -1 : 1;
+		if (a->rank != b->rank) return a->rank < b->rank ? -1 : 1;
+		if (a->node != b->node) return a->node < b->node ? -1 : 1;
+		return a->cpu - b->cpu;
 	}
 
-	void ResetContigencyTable_3()
+public:
+	uint32 numNode;
+	uint32 numCpu;
+	CpuInfo *cpus;
+
+	uint32 numThreads;
+	uint32 policy;
+	int32 *cpuOfThread;   // -1 if the thread is not pinned
+	uint32 *nodeOfThread; // NUMA node whose genotype replica the thread reads
+
+	Placement()
 	{
-		memset(contingencyCtrl, 0, 64 * sizeof(sampleIdx));
-		memset(contingencyCase, 0, 64 * sizeof(sampleIdx));
+		numNode = 1;
+		numCpu = 0;
+		numThreads = 0;
+		policy = PIN_NONE;
+		cpus = NULL;
+		cpuOfThread = NULL;
+		nodeOfThread = NULL;
 	}
 
-	void ResetContigencyTable_4()
+	~Placement()
 	{
-		memset(contingencyCtrl, 0, 256 * sizeof(sampleIdx));
-		memset(contingencyCase, 0, 256 * sizeof(sampleIdx));
+		delete[] cpus;
+		delete[] cpuOfThread;
+		delete[] nodeOfThread;
 	}
 
-	double Gini_1()
+	// Find the cpus this process may run on together with their node, core and SMT rank.
+	void Detect()
 	{
-		const uint32 entry = 3;
-		double purity = 0;
+		cpus = new CpuInfo[MAX_CPU];
+		NULL_CHECK(cpus);
+		numCpu = 0;
+		numNode = 1;
+#ifdef __linux__
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		if (sched_getaffinity(0, sizeof(allowed), &allowed))
+			return;
+
+		int32 nodeOfCpu[MAX_CPU];
+		for (uint32 c = 0; c < MAX_CPU; c++)
+			nodeOfCpu[c] = 0;
+
+		char fn[256];
+		char buf[4096];
+		int32 list[MAX_CPU];
+		for (uint32 node = 0; node < MAX_NODE; node++)
+		{
+			sprintf(fn, "/sys/devices/system/node/node%u/cpulist", node);
+			if (!ReadSysFile(fn, buf, sizeof(buf)))
+				continue;
+			uint32 n = ParseCpuList(buf, list, MAX_CPU);
+			for (uint32 j = 0; j < n; j++)
+				if (list[j] < MAX_CPU)
+					nodeOfCpu[list[j]] = node;
+			if (node + 1 > numNode)
+				numNode = node + 1;
+		}
 
-		for (uint32 i = 0; i < entry; i++)
+		for (int32 c = 0; c < MAX_CPU; c++)
 		{
-			uint32 index = cti[i];
-			double nCase = (double)contingencyCase[index];
-			double nCtrl = (double)contingencyCtrl[index];
-			double sum = nCase + nCtrl;
-			if (sum)
-				purity += (P2(nCase) + P2(nCtrl)) / (sum * dataset->numSample);
+			if (!CPU_ISSET(c, &allowed))
+				continue;
+			CpuInfo &ci = cpus[numCpu++];
+			ci.cpu = c;
+			ci.node = nodeOfCpu[c];
+			ci.package = ReadSysValue("/sys/devices/system/cpu/cpu%d/topology/physical_package_id", c);
+			ci.core = ReadSysValue("/sys/devices/system/cpu/cpu%d/topology/core_id", c);
+			ci.smt = 0;
+			sprintf(fn, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", c);
+			if (ReadSysFile(fn, buf, sizeof(buf)))
+			{
+				uint32 n = ParseCpuList(buf, list, MAX_CPU);
+				for (uint32 j = 0; j < n; j++)
+					if (list[j] == c)
+						ci.smt = j;
+			}
 		}
-		return purity;
+
+		// rank physical cores within each node
+		for (uint32 i = 0; i < numCpu; i++)
+		{
+			cpus[i].rank = 0;
+			for (uint32 j = 0; j < numCpu; j++)
+			{
+				if (cpus[j].node != cpus[i].node || cpus[j].smt != 0)
+					continue;
+				if (cpus[j].package < cpus[i].package || (cpus[j].package == cpus[i].package && cpus[j].core < cpus[i].core))
+					cpus[i].rank++;
+			}
+		}
+#endif
 	}
 
-	double Gini_2()
+	// Assign a cpu and a node to each thread according to the policy.
+	void Plan(uint32 threads, uint32 pinPolicy)
 	{
-		const uint32 entry = 9;
-		double purity = 0;
+		numThreads = threads;
+		policy = pinPolicy;
+		cpuOfThread = new int32[numThreads];
+		nodeOfThread = new uint32[numThreads];
+		NULL_CHECK(cpuOfThread);
+		NULL_CHECK(nodeOfThread);
+
+		if (policy != PIN_NONE)
+		{
+			Detect();
+			if (numCpu == 0)
+			{
+				printf("\n*** WARNING: cannot detect cpu topology, threads are not pinned");
+				policy = PIN_NONE;
+			}
+		}
 
-		for (uint32 i = 0; i < entry; i++)
+		if (policy == PIN_COMPACT) qsort(cpus, numCpu, sizeof(CpuInfo), CompareCompact);
+		if (policy == PIN_CORES) qsort(cpus, numCpu, sizeof(CpuInfo), CompareCores);
+		if (policy == PIN_SCATTER) qsort(cpus, numCpu, sizeof(CpuInfo), CompareScatter);
+
+		for (uint32 t = 0; t < numThreads; t++)
 		{
-			uint32 index = cti[i];
-			double nCase = (double)contingencyCase[index];
-			double nCtrl = (double)contingencyCtrl[index];
-			double sum = nCase + nCtrl;
-			if (sum)
-				purity += (P2(nCase) + P2(nCtrl)) / (sum * dataset->numSample);
+			if (policy == PIN_NONE)
+			{
+				cpuOfThread[t] = -1;
+				nodeOfThread[t] = 0;
+			}
+			else
+			{
+				cpuOfThread[t] = cpus[t % numCpu].cpu;
+				nodeOfThread[t] = cpus[t % numCpu].node;
+			}
 		}
-		return purity;
-	}
-	
-	double Gini_3()
-	{
-		const uint32 entry = 27;
-		double purity = 0;
 
-		for (uint32 i = 0; i < entry; i++)
+		if (policy != PIN_NONE)
 		{
-			uint32 index = cti[i];
-			double nCase = (double)contingencyCase[index];
-			double nCtrl = (double)contingencyCtrl[index];
-			double sum = nCase + nCtrl;
-			if (sum)
-				purity += (P2(nCase) + P2(nCtrl)) / (sum * dataset->numSample);
+			printf("\nPinning %u threads over %u cpus and %u NUMA nodes", numThreads, numCpu, numNode);
+			for (uint32 t = 0; t < numThreads; t++)
+				printf("\n thread %4u -> cpu %4d (node %u)", t, cpuOfThread[t], nodeOfThread[t]);
 		}
-		return purity;
 	}
 
-	double Gini_4()
+	bool NodeUsed(uint32 node)
 	{
-		const uint32 entry = 81;
-		double purity = 0;
+		for (uint32 t = 0; t < numThreads; t++)
+			if (nodeOfThread[t] == node)
+				return true;
+		return false;
+	}
 
-		for (uint32 i = 0; i < entry; i++)
-		{
-			uint32 index = cti[i];
-			double nCase = (double)contingencyCase[index];
-			double nCtrl = (double)contingencyCtrl[index];
-			double sum = nCase + nCtrl;
-			if (sum)
-				purity += (P2(nCase) + P2(nCtrl)) / (sum * dataset->numSample);
-		}
-		return purity;
+	// Pin the calling thread to a cpu
+	static void PinCpu(int32 cpu)
+	{
+#ifdef __linux__
+		if (cpu < 0)
+			return;
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+			printf("\n*** WARNING: cannot pin thread to cpu %d", cpu);
+#endif
 	}
 
-	void Epi_1(uint32 id)
+	void Pin(uint32 t)
 	{
-		const uint32 OIDX = 0; // SNP
-		threadIdx = id;
+		PinCpu(cpuOfThread[t]);
+	}
 
-		AllocateThreadMemory();
+	// any cpu of the node (used to first-touch the node's replica)
+	int32 CpuOfNode(uint32 node)
+	{
+		for (uint32 t = 0; t < numThreads; t++)
+			if (nodeOfThread[t] == node)
+				return cpuOfThread[t];
+		return -1;
+	}
+};
 
-		printf("Thread %4u starting ...\n", threadIdx);
+class Dataset;
 
-		varIdx idx[1];
+struct HashedVariable
+{
+	uint64 hash;
+	varIdx var;
+};
 
-		for (idx[0] = 0; idx[0] < dataset->numVariable; idx[0]++)
-		{
-			uint32 pt = (idx[0] % args.numThreads);
-			if (pt == threadIdx)
-			{
-#ifdef PTEST
-				clock_t xc1 = clock();
-#endif
-				ResetContigencyTable_1();
-#ifdef PTEST
-				clock_t xc2 = clock();
-#endif
-				OR_1x(idx[0]);
-#ifdef PTEST
-				clock_t xc3 = clock();
-#endif
-				// compute purity
-				double p = Gini_1();
-#ifdef PTEST
-				clock_t xc4 = clock();
-#endif
-				// report SNP combination if purity meet threshold
-				if (args.printP[OIDX])
-					if (p >= args.p[OIDX])
-						fprintf(topPfile[threadIdx], "%f,%s\n", p, dataset->nameVariable[idx[0]]);
+int CompareHashed(const void *x, const void *y)
+{
+	const HashedVariable *a = (const HashedVariable *)x;
+	const HashedVariable *b = (const HashedVariable *)y;
+	if (a->hash != b->hash)
+		return (a->hash < b->hash) ? -1 : 1;
+	return (a->var < b->var) ? -1 : (a->var > b->var);
+}
 
-				// Save Purity to compute IG of next order
-				if (args.saveP[OIDX])
-					SnpPurity[idx[0]] = p;
+struct ReplicaData
+{
+	Dataset *dataset;
+	uint32 node;
+	int32 cpu; // a cpu of the node
+};
 
-				// compute Information Gained
-				if (args.computeIG[OIDX])
-				{
-					double max_p = dataset->setPurity;
+class Dataset
+{
+	// contigency table index translation
+	// note that 3 or 0b11 is not a valid genotype and should not be considered in Gini Computation.
+	uint64 CaseIndex(varIdx v, sampleIdx s) { return ((v * numByteCase) + s); }	// get the byte index of sample in data
+	uint64 CtrlIndex(varIdx v, sampleIdx s) { return ((v * numByteCtrl) + s); }	// get the byte index of sample in data
 
-					double ig = p - max_p;
+public:
+
+	uint32 order;
+
+	uint32 *labels;
+
+	sampleIdx numSample;
+
+	sampleIdx numCase;
+	sampleIdx numCtrl;
+
+	uint32 numWordCase;// number of machine word used to store Case data (each sample is a byte)
+	uint32 numWordCtrl;// number of machine word used to store Ctrl data (each sample is a byte)
+
+	uint32 numByteCase; // numWordCase * sizeof(word)
+	uint32 numByteCtrl; // numWordCtrl * sizeof(word)
+
+	uint8 *byteCase; // byte pointer to store genotype data (kernels shift it in register for each order)
+	uint8 *byteCtrl; // byte pointer to store genotype data (kernels shift it in register for each order)
+
+	word *wordCase; // the wrod pointer to byteCase
+	word *wordCtrl; // the wrod pointer to byteCtrl
+
+	uint32 model;      // MODEL_XXX the genotypes were recoded to when loaded
+	uint32 numBitCase; // number of machine word used to store one bit per Case sample (-model dominant or recessive)
+	uint32 numBitCtrl; // number of machine word used to store one bit per Ctrl sample (-model dominant or recessive)
+	word *bitCase;     // one bit per sample set for genotype 1 of the recoded genotypes, NULL for the additive model
+	word *bitCtrl;     // one bit per sample set for genotype 1 of the recoded genotypes, NULL for the additive model
+
+	word *nodeCase[MAX_NODE]; // per NUMA node replica of wordCase (point to wordCase until a -numa run replicates the node)
+	word *nodeCtrl[MAX_NODE]; // per NUMA node replica of wordCtrl (point to wordCtrl until a -numa run replicates the node)
+
+	uint32 pageMode; // PAGE_XXX used to allocate the genotype data
+
+	uint32 numLine;
+	varIdx numVariable;
+	char **nameVariable;
+	char ***alias; // other names of each variable with the same genotypes, NULL terminated (-collapse), NULL for none
+
+	double setPurity; // purity of the original set
+
+	sampleIdx *contingency_table; // should be small enough to remain in cache
+
+	// FreeMemory can free a dataset that could not be read
+	Dataset()
+	{
+		memset(this, 0, sizeof(Dataset));
+	}
+
+	void FreeMemory()
+	{
+		delete[] labels;
+
+		for (uint32 i = 0; i < numVariable; i++)
+			delete[] nameVariable[i];
+		delete nameVariable;
+
+		if (alias)
+		{
+			for (varIdx v = 0; v < numVariable; v++)
+			{
+				for (uint32 m = 0; alias[v] && alias[v][m]; m++)
+					delete[] alias[v][m];
+				delete[] alias[v];
+			}
+			delete[] alias;
+		}
+
+		FreeWords(wordCase, (uint64)numLine * numWordCase, pageMode);
+		FreeWords(wordCtrl, (uint64)numLine * numWordCtrl, pageMode);
+		delete[] bitCase;
+		delete[] bitCtrl;
+
+		for (uint32 n = 0; n < MAX_NODE; n++)
+		{
+			if (nodeCase[n] == wordCase)
+				continue;
+			FreeWords(nodeCase[n], (uint64)numLine * numWordCase, pageMode);
+			FreeWords(nodeCtrl[n], (uint64)numLine * numWordCtrl, pageMode);
+		}
+	}
+
+	// Count number of line in a file to see how many variable exits (0 if it cannot be opened).
+	uint32 LineCount(const char *fn)
+	{
+		printf("\nCounting lines in %s.", fn);
+
+		FILE *f;
+		uint32 lines = 0;
+
+		f = fopen(fn, "r");
+		if (!f)
+			return 0;
+
+		char ch;
+		for (ch = getc(f); ch != EOF; ch = getc(f)) if (ch == '\n') lines = lines + 1;
+
+		fclose(f);
+
+		printf("\n%s has %u lines\n", fn, lines);
+		return lines;
+	}
+
+	// Read the labels from the header and find the number of word and byte per variable
+	bool ReadHeader(CsvParser *csvparser)
+	{
+		const CsvRow *header = CsvParser_getHeader(csvparser);
+		if (!header)
+			INPUT_ERROR("The dataset has no header");
+
+		const char **headerFields = CsvParser_getFields(header);
+
+		if (CsvParser_getNumFields(header) - 1 >= pow(2, sizeof(sampleIdx) * 8))
+			INPUT_ERROR("Change sampleIdx type to support number of samples exist in dataset");
+		numSample = CsvParser_getNumFields(header) - 1;
+
+		labels = new uint32[numSample];
+		NULL_CHECK(labels);
+
+		numCase = 0;
+		numCtrl = 0;
+		for (sampleIdx i = 0; i < numSample; i++)
+		{
+			sscanf(headerFields[i + 1], "%u", &labels[i]);
+			if (labels[i] > 1) INPUT_ERROR("Class shold be 0 or 1");
+
+			if (labels[i])
+				numCase++;
+			else
+				numCtrl++;
+		}
+
+		// find number of word and byte per variable in Case and Ctrl
+		numWordCase = numCase / byte_in_word;
+		numWordCtrl = numCtrl / byte_in_word;
+
+		if (numCase % byte_in_word) numWordCase++;
+		if (numCtrl % byte_in_word) numWordCtrl++;
+
+		numByteCase = numWordCase * byte_in_word;
+		numByteCtrl = numWordCtrl * byte_in_word;
+		return true;
+	}
+
+	// Read only the number of variables and the header of a dataset (used by -plan)
+	bool ReadDimensions(const char *fn)
+	{
+		numLine = LineCount(fn);
+		if (!numLine)
+			INPUT_ERROR("Cannot read the dataset");
+		CsvParser *csvparser = CsvParser_new(fn, ",", 1);
+		bool valid = ReadHeader(csvparser);
+		CsvParser_destroy(csvparser);
+		numVariable = numLine - 1;
+		return valid;
+	}
+
+	// Replace the genotype data by nv random variables with the same samples (used to calibrate -plan)
+	void Synthesize(varIdx nv)
+	{
+		numLine = nv;
+		numVariable = nv;
+		nameVariable = new char*[nv];
+		alias = NULL;
+		NULL_CHECK(nameVariable);
+
+		wordCase = AllocateWords((uint64)numLine * numWordCase, pageMode);
+		wordCtrl = AllocateWords((uint64)numLine * numWordCtrl, pageMode);
+		memset(wordCase, 0, (uint64)numLine * numByteCase);
+		memset(wordCtrl, 0, (uint64)numLine * numByteCtrl);
+		byteCase = (uint8*)wordCase;
+		byteCtrl = (uint8*)wordCtrl;
+
+		srand(1);
+		for (varIdx v = 0; v < nv; v++)
+		{
+			nameVariable[v] = new char[16];
+			sprintf(nameVariable[v], "calib%u", v);
+			for (uint32 i = 0; i < numCase; i++)
+				byteCase[CaseIndex(v, i)] = (uint8)(rand() % 3);
+			for (uint32 i = 0; i < numCtrl; i++)
+				byteCtrl[CtrlIndex(v, i)] = (uint8)(rand() % 3);
+		}
+
+		for (uint32 n = 0; n < MAX_NODE; n++)
+		{
+			nodeCase[n] = wordCase;
+			nodeCtrl[n] = wordCtrl;
+		}
+	}
+
+	// This function read data from file, false if it is not a valid dataset
+	bool ReadDataset(const char *fn)
+	{
+		printf("\nloading dataset %s", fn);
+		alias = NULL;
+		model = MODEL_ADDITIVE;
+		numBitCase = 0;
+		numBitCtrl = 0;
+		bitCase = NULL;
+		bitCtrl = NULL;
+
+		numLine = LineCount(fn);
+		if (!numLine)
+			INPUT_ERROR("Cannot read the dataset");
+		nameVariable = new char*[numLine - 1];
+		NULL_CHECK(nameVariable);
+
+		CsvParser *csvparser = CsvParser_new(fn, ",", 1);
+		CsvRow *row;
+
+		if (!ReadHeader(csvparser))
+		{
+			CsvParser_destroy(csvparser);
+			return false;
+		}
+
+		// allocate memory (padding samples of the last word are counted as genotype 0 and must be zero)
+		wordCase = AllocateWords((uint64)numLine * numWordCase, pageMode);
+		wordCtrl = AllocateWords((uint64)numLine * numWordCtrl, pageMode);
+
+		NULL_CHECK(wordCase);
+		NULL_CHECK(wordCtrl);
+
+		memset(wordCase, 0, (uint64)numLine * numByteCase);
+		memset(wordCtrl, 0, (uint64)numLine * numByteCtrl);
+
+		// convert to byte address
+		byteCase = (uint8*)wordCase;
+		byteCtrl = (uint8*)wordCtrl;
+
+		numVariable = 0;
+		while ((row = CsvParser_getRow(csvparser)))
+		{
+			const char **rowFields = CsvParser_getFields(row);
+
+			if (CsvParser_getNumFields(row) != (numSample + 1))
+			{
+				CsvParser_destroy_row(row);
+				CsvParser_destroy(csvparser);
+				INPUT_ERROR("Number of fields does not match the first line in the file");
+			}
+
+			nameVariable[numVariable] = new char[strlen(rowFields[0]) + 1];
+			strcpy(nameVariable[numVariable], rowFields[0]);
+			numVariable++;
+
+			uint32 idxCase = 0;
+			uint32 idxCtrl = 0;
+
+			for (sampleIdx i = 0; i < numSample; i++)
+			{
+				uint32 gt;
+				sscanf(rowFields[i + 1], "%u", &gt);
+				if (gt > 2)
+				{
+					CsvParser_destroy_row(row);
+					CsvParser_destroy(csvparser);
+					INPUT_ERROR("Values shold be 0 or 1 or 2");
+				}
+				if (labels[i])
+				{
+					byteCase[CaseIndex(numVariable - 1, idxCase)] = (uint8)gt;
+					idxCase++;
+				}
+				else
+				{
+					byteCtrl[CtrlIndex(numVariable - 1, idxCtrl)] = (uint8)gt;
+					idxCtrl++;
+				}
+			}
+			CsvParser_destroy_row(row);
+		}
+
+		CsvParser_destroy(csvparser);
+
+		return true;
+	}
+
+	// This function write data from file (to test ReadDataset function)
+	void WriteDataset(const char *fn)
+	{
+		printf("\nWrite dataset to %s", fn);
+
+		FILE *f = fopen(fn, "w");
+		NULL_CHECK(f);
+
+		fprintf(f, "Var\\Class");
+
+		for (uint32 i = 0; i < numSample; i++)
+		{
+			fprintf(f, ",%u", labels[i]);
+		}
+		fprintf(f, "\n");
+
+		for (uint32 j = 0; j < numVariable; j++)
+		{
+			fprintf(f, "%s", nameVariable[j]);
+
+			uint32 idxCase = 0;
+			uint32 idxCtrl = 0;
+
+			for (uint32 i = 0; i < numSample; i++)
+			{
+				if (labels[i])
+				{
+					fprintf(f, ",%u", byteCase[CaseIndex(j, idxCase)]);
+					idxCase++;
+				}
+				else
+				{
+					fprintf(f, ",%u", byteCtrl[CtrlIndex(j, idxCtrl)]);
+					idxCtrl++;
+				}
+			}
+			fprintf(f, "\n");
+		}
+		fclose(f);
+		return;
+	}
+
+	void ComputeSetPurity()
+	{
+		numCase = 0;
+		numCtrl = 0;
+		for (sampleIdx i = 0; i < numSample; i++)
+			if (labels[i]) numCase++; else numCtrl++;
+		setPurity = P2((double)numCase / numSample) + P2((double)numCtrl / numSample);
+		printf("\nSet Purity of the dataset is %f", setPurity);
+	}
+
+	// Copy the genotype data to memory first-touched by a thread running on the node
+	void ReplicateNode(uint32 node, int32 cpu)
+	{
+		Placement::PinCpu(cpu);
+		word *replicaCase = AllocateWords((uint64)numLine * numWordCase, pageMode);
+		word *replicaCtrl = AllocateWords((uint64)numLine * numWordCtrl, pageMode);
+		memcpy(replicaCase, wordCase, (uint64)numVariable * numByteCase);
+		memcpy(replicaCtrl, wordCtrl, (uint64)numVariable * numByteCtrl);
+		nodeCase[node] = replicaCase;
+		nodeCtrl[node] = replicaCtrl;
+	}
+
+	// Replicate the genotype data on the nodes used by the threads of a run that are not replicated yet
+	void Replicate(Placement *placement, ARGS args)
+	{
+		if (!args.numa || placement->policy == PIN_NONE || placement->numNode < 2)
+			return;
+
+		for (uint32 n = 0; n < placement->numNode; n++)
+		{
+			if (!placement->NodeUsed(n) || nodeCase[n] != wordCase)
+				continue;
+			pthread_t thread;
+			ReplicaData rd;
+			rd.dataset = this;
+			rd.node = n;
+			rd.cpu = placement->CpuOfNode(n);
+			pthread_create(&thread, NULL, ReplicaThread, &rd);
+			pthread_join(thread, NULL);
+			printf("\nGenotype data replicated on NUMA node %u", n);
+		}
+	}
+
+	// the genotypes of a variable are all the same value
+	bool Monomorphic(varIdx v)
+	{
+		uint8 g = numCase ? byteCase[CaseIndex(v, 0)] : byteCtrl[CtrlIndex(v, 0)];
+		for (sampleIdx i = 0; i < numCase; i++)
+			if (byteCase[CaseIndex(v, i)] != g)
+				return false;
+		for (sampleIdx i = 0; i < numCtrl; i++)
+			if (byteCtrl[CtrlIndex(v, i)] != g)
+				return false;
+		return true;
+	}
+
+	bool SameGenotypes(varIdx a, varIdx b)
+	{
+		return !memcmp(&wordCase[a * numWordCase], &wordCase[b * numWordCase], numByteCase)
+			&& !memcmp(&wordCtrl[a * numWordCtrl], &wordCtrl[b * numWordCtrl], numByteCtrl);
+	}
+
+	uint64 VariableHash(varIdx v)
+	{
+		uint64 h = 0x9E3779B97F4A7C15ULL;
+		for (uint32 i = 0; i < numWordCase + numWordCtrl; i++)
+		{
+			h ^= (i < numWordCase) ? wordCase[v * numWordCase + i] : wordCtrl[v * numWordCtrl + i - numWordCase];
+			h *= 0xFF51AFD7ED558CCDULL;
+			h ^= h >> 29;
+		}
+		return h;
+	}
+
+	// Keep the first variable of each set with identical genotypes and drop the monomorphic ones (-collapse).
+	// The other names of a set are kept in alias, the combinations of a set stand for those of all its names.
+	// False, with the dataset unchanged, if every variable is monomorphic.
+	bool Collapse()
+	{
+		HashedVariable *hashed = new HashedVariable[numVariable];
+		varIdx *first = new varIdx[numVariable]; // first variable of the set of each variable, numVariable if monomorphic
+		uint32 *numAlias = new uint32[numVariable];
+		NULL_CHECK(hashed);
+		NULL_CHECK(first);
+		NULL_CHECK(numAlias);
+		memset(numAlias, 0, numVariable * sizeof(uint32));
+
+		// equal genotypes have equal hashes, a run of equal hashes is sorted by variable
+		for (varIdx v = 0; v < numVariable; v++)
+		{
+			hashed[v].hash = VariableHash(v);
+			hashed[v].var = v;
+		}
+		qsort(hashed, numVariable, sizeof(HashedVariable), CompareHashed);
+
+		varIdx numMonomorphic = 0;
+		varIdx numDuplicate = 0;
+		for (varIdx i = 0; i < numVariable; i++)
+		{
+			varIdx v = hashed[i].var;
+			first[v] = v;
+			if (Monomorphic(v))
+			{
+				first[v] = numVariable;
+				numMonomorphic++;
+				continue;
+			}
+			for (varIdx j = i; j-- > 0 && hashed[j].hash == hashed[i].hash;)
+			{
+				varIdx u = hashed[j].var;
+				if (first[u] == u && SameGenotypes(u, v))
+				{
+					first[v] = u;
+					numAlias[u]++;
+					numDuplicate++;
+					break;
+				}
+			}
+		}
+		if (numMonomorphic == numVariable)
+		{
+			delete[] hashed;
+			delete[] first;
+			delete[] numAlias;
+			INPUT_ERROR("All SNPs are monomorphic");
+		}
+
+		// move the first variable of each set down, the dataset order is kept
+		alias = new char **[numVariable];
+		varIdx *position = new varIdx[numVariable];
+		char **name = new char *[numVariable]; // the names before they move
+		NULL_CHECK(alias);
+		NULL_CHECK(position);
+		NULL_CHECK(name);
+		memset(alias, 0, numVariable * sizeof(char **));
+		memcpy(name, nameVariable, numVariable * sizeof(char *));
+		varIdx next = 0;
+		for (varIdx v = 0; v < numVariable; v++)
+		{
+			if (first[v] != v)
+				continue;
+			position[v] = next;
+			if (next != v)
+			{
+				memmove(&wordCase[next * numWordCase], &wordCase[v * numWordCase], numByteCase);
+				memmove(&wordCtrl[next * numWordCtrl], &wordCtrl[v * numWordCtrl], numByteCtrl);
+				nameVariable[next] = name[v];
+			}
+			if (numAlias[v])
+			{
+				alias[next] = new char *[numAlias[v] + 1];
+				NULL_CHECK(alias[next]);
+				alias[next][0] = NULL;
+			}
+			next++;
+		}
+		for (varIdx v = 0; v < numVariable; v++)
+		{
+			if (first[v] == v)
+				continue;
+			if (first[v] == numVariable)
+			{
+				delete[] name[v];
+				continue;
+			}
+			char **a = alias[position[first[v]]];
+			uint32 m = 0;
+			while (a[m])
+				m++;
+			a[m] = name[v];
+			a[m + 1] = NULL;
+		}
+
+		printf("\nCollapsed %u SNPs to %u: %u duplicate and %u monomorphic SNPs", numVariable, next, numDuplicate, numMonomorphic);
+		numVariable = next;
+
+		delete[] hashed;
+		delete[] first;
+		delete[] numAlias;
+		delete[] position;
+		delete[] name;
+		return true;
+	}
+
+	void Init()
+	{
+		ComputeSetPurity();
+		for (uint32 n = 0; n < MAX_NODE; n++)
+		{
+			nodeCase[n] = wordCase;
+			nodeCtrl[n] = wordCtrl;
+		}
+		if (model != MODEL_ADDITIVE)
+			BuildBits();
+	}
+
+	// recode the genotypes to 0 and 1 under a dominant or recessive model (-model), before Collapse and Init
+	void Recode(uint32 m)
+	{
+		model = m;
+		if (model == MODEL_ADDITIVE)
+			return;
+
+		uint64 n = (uint64)numVariable * numByteCase;
+		for (uint64 i = 0; i < n; i++)
+			byteCase[i] = (model == MODEL_DOMINANT) ? (byteCase[i] != 0) : (byteCase[i] == 2);
+		n = (uint64)numVariable * numByteCtrl;
+		for (uint64 i = 0; i < n; i++)
+			byteCtrl[i] = (model == MODEL_DOMINANT) ? (byteCtrl[i] != 0) : (byteCtrl[i] == 2);
+		printf("\nGenotypes recoded to the %s model", (model == MODEL_DOMINANT) ? "dominant" : "recessive");
+	}
+
+	// one bit per sample of the recoded genotypes, the padding bits of the last word are zero
+	void BuildBits()
+	{
+		numBitCase = (numCase + bit_in_word - 1) / bit_in_word;
+		numBitCtrl = (numCtrl + bit_in_word - 1) / bit_in_word;
+		bitCase = new word[(uint64)numVariable * numBitCase + 1];
+		bitCtrl = new word[(uint64)numVariable * numBitCtrl + 1];
+		NULL_CHECK(bitCase);
+		NULL_CHECK(bitCtrl);
+		memset(bitCase, 0, ((uint64)numVariable * numBitCase + 1) * sizeof(word));
+		memset(bitCtrl, 0, ((uint64)numVariable * numBitCtrl + 1) * sizeof(word));
+
+		for (varIdx v = 0; v < numVariable; v++)
+		{
+			for (sampleIdx i = 0; i < numCase; i++)
+				if (byteCase[(uint64)v * numByteCase + i])
+					bitCase[(uint64)v * numBitCase + i / bit_in_word] |= (word)1 << (i % bit_in_word);
+			for (sampleIdx i = 0; i < numCtrl; i++)
+				if (byteCtrl[(uint64)v * numByteCtrl + i])
+					bitCtrl[(uint64)v * numBitCtrl + i / bit_in_word] |= (word)1 << (i % bit_in_word);
+		}
+	}
+
+	// hash of the labels and genotypes, a purity cache file is only used by the dataset that wrote it
+	uint64 Hash()
+	{
+		uint64 h = 0x9E3779B97F4A7C15ULL ^ ((uint64)numVariable << 40) ^ ((uint64)numCase << 20) ^ numCtrl;
+		uint64 numCaseWord = (uint64)numVariable * numWordCase;
+		uint64 numCtrlWord = (uint64)numVariable * numWordCtrl;
+		for (uint64 i = 0; i < numCaseWord + numCtrlWord; i++)
+		{
+			h ^= (i < numCaseWord) ? wordCase[i] : wordCtrl[i - numCaseWord];
+			h *= 0xFF51AFD7ED558CCDULL;
+			h ^= h >> 29;
+		}
+		return h;
+	}
+
+	word *GetVarCase(varIdx vi, uint32 node)
+	{
+		return &nodeCase[node][vi*numWordCase];
+	}
+
+	word *GetVarCtrl(varIdx vi, uint32 node)
+	{
+		return &nodeCtrl[node][vi*numWordCtrl];
+	}
+
+	word *GetVarBitCase(varIdx vi)
+	{
+		return &bitCase[(uint64)vi * numBitCase];
+	}
+
+	word *GetVarBitCtrl(varIdx vi)
+	{
+		return &bitCtrl[(uint64)vi * numBitCtrl];
+	}
+
+	static void *ReplicaThread(void *t)
+	{
+		ReplicaData *rd = (ReplicaData *)t;
+		rd->dataset->ReplicateNode(rd->node, rd->cpu);
+		return NULL;
+	}
+};
+
+// Header of a count file (-counts), followed by the counts of each SNP, then of each pair of SNPs
+struct CountFileHeader
+{
+	char magic[8];      // "BITEPICT"
+	uint64 numVariable;
+	uint64 nameHash;    // hash of the SNP names in the dataset order, every batch has the same SNPs
+	uint64 numCase;     // samples of all the batches counted
+	uint64 numCtrl;
+	uint64 numBatch;
+	uint64 count;       // number of counts that follow
+};
+
+// Genotype counts of every SNP and pair of SNPs over the sample batches added so far (-counts). A run adds
+// the counts of its dataset, one more batch of samples, and takes the purities of the SNPs and pairs from the
+// sums, so that the samples of the earlier batches are never read again. Each SNP has 3 case then 3 control
+// counts, each pair 9 and 9, in the order of cti. The padding of the last word of a batch is not counted,
+// the purities count the padding of a dataset of all the samples, as a run on such a dataset would.
+class CountTable
+{
+	uint32 *cells;
+	uint64 mappedBytes; // bytes mapped from the count file, 0 if cells was allocated
+
+	uint64 Pair(varIdx a, varIdx b)
+	{
+		return (uint64)a * header.numVariable - (uint64)a * (a + 1) / 2 + (b - a - 1);
+	}
+
+	static uint64 NameHash(Dataset *d)
+	{
+		uint64 h = 0x9E3779B97F4A7C15ULL ^ d->numVariable;
+		for (varIdx v = 0; v < d->numVariable; v++)
+			for (const char *c = d->nameVariable[v]; ; c++)
+			{
+				h ^= (uint8)*c;
+				h *= 0xFF51AFD7ED558CCDULL;
+				h ^= h >> 29;
+				if (!*c)
+					break;
+			}
+		return h;
+	}
+
+	// map the counts of the count file, *found is false if there is none yet, false if it is not valid
+	bool Map(const char *fn, uint64 nameHash, uint64 count, bool *found)
+	{
+		FILE *f = fopen(fn, "rb");
+		*found = f != NULL;
+		if (!f)
+			return true;
+		bool valid = fread(&header, sizeof(header), 1, f) == 1;
+		if (!valid || memcmp(header.magic, "BITEPICT", 8) || header.nameHash != nameHash || header.count != count)
+		{
+			fclose(f);
+			INPUT_ERROR("The count file does not hold the SNPs of the dataset");
+		}
+		uint64 bytes = sizeof(header) + count * sizeof(uint32);
+
+#ifdef _MSC_VER
+		cells = new uint32[count];
+		NULL_CHECK(cells);
+		valid = fread(cells, sizeof(uint32), count, f) == count;
+		fclose(f);
+#else
+		fclose(f);
+		int fd = open(fn, O_RDONLY);
+		struct stat st;
+		valid = fd >= 0 && !fstat(fd, &st) && (uint64)st.st_size == bytes;
+		void *map = valid ? mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		if (fd >= 0)
+			close(fd);
+		valid = map != MAP_FAILED;
+		if (valid)
+		{
+			// the batch is added to private pages, the file is replaced once the run is complete
+			cells = (uint32 *)((char *)map + sizeof(header));
+			mappedBytes = bytes;
+		}
+#endif
+		if (!valid)
+		{
+			delete[] cells; // read without a map
+			cells = NULL;
+			INPUT_ERROR("The count file is not complete");
+		}
+		return true;
+	}
+
+public:
+	CountFileHeader header;
+	uint32 batchPadCase; // padding samples of the batch, counted as genotype 0 by the kernels
+	uint32 batchPadCtrl;
+	uint32 padCase;      // padding samples of a dataset of all the samples
+	uint32 padCtrl;
+	double setPurity;    // purity of all the samples
+
+	CountTable()
+	{
+		cells = NULL;
+		mappedBytes = 0;
+	}
+
+	~CountTable()
+	{
+#ifndef _MSC_VER
+		if (mappedBytes)
+		{
+			munmap((char *)cells - sizeof(header), mappedBytes);
+			return;
+		}
+#endif
+		delete[] cells;
+	}
+
+	// the counts of the earlier batches in fn, or none if it does not exist yet, with the samples of dataset d to add,
+	// false if fn holds the counts of other SNPs or is not complete
+	bool Open(const char *fn, Dataset *d)
+	{
+		varIdx n = d->numVariable;
+		uint64 count = 6 * (uint64)n + 18 * ((uint64)n * (n - 1) / 2);
+		uint64 nameHash = NameHash(d);
+		bool found;
+		if (!Map(fn, nameHash, count, &found))
+			return false;
+		if (!found)
+		{
+			memcpy(header.magic, "BITEPICT", 8);
+			header.numVariable = n;
+			header.nameHash = nameHash;
+			header.numCase = header.numCtrl = header.numBatch = 0;
+			header.count = count;
+			cells = new uint32[count];
+			NULL_CHECK(cells);
+			memset(cells, 0, count * sizeof(uint32));
+		}
+
+		header.numCase += d->numCase;
+		header.numCtrl += d->numCtrl;
+		header.numBatch++;
+		batchPadCase = (uint32)(d->numByteCase - d->numCase);
+		batchPadCtrl = (uint32)(d->numByteCtrl - d->numCtrl);
+		padCase = (uint32)((byte_in_word - header.numCase % byte_in_word) % byte_in_word);
+		padCtrl = (uint32)((byte_in_word - header.numCtrl % byte_in_word) % byte_in_word);
+		double numSample = (double)(header.numCase + header.numCtrl);
+		setPurity = P2((double)header.numCase / numSample) + P2((double)header.numCtrl / numSample);
+		printf("\nCounts of %llu cases and %llu controls in %llu batches, set purity %f\n", (unsigned long long)header.numCase, (unsigned long long)header.numCtrl, (unsigned long long)header.numBatch, setPurity);
+		return true;
+	}
+
+	// add the batch counts of a SNP (o = 0) or pair (o = 1), each one added by one thread only,
+	// and return its purity over all the samples
+	double Add(uint32 o, varIdx *idx, sampleIdx *caseTable, sampleIdx *ctrlTable)
+	{
+		uint32 entry = o ? 9 : 3;
+		uint32 *c = o ? &cells[6 * header.numVariable + 18 * Pair(idx[0], idx[1])] : &cells[6 * (uint64)idx[0]];
+		double numSample = (double)(header.numCase + header.numCtrl);
+		double purity = 0;
+		for (uint32 i = 0; i < entry; i++)
+		{
+			uint32 index = cti[i];
+			c[i] += caseTable[index] - (index ? 0 : batchPadCase);
+			c[entry + i] += ctrlTable[index] - (index ? 0 : batchPadCtrl);
+			double nCase = (double)(c[i] + (index ? 0 : padCase));
+			double nCtrl = (double)(c[entry + i] + (index ? 0 : padCtrl));
+			double sum = nCase + nCtrl;
+			if (sum)
+				purity += (P2(nCase) + P2(nCtrl)) / (sum * numSample);
+		}
+		return purity;
+	}
+
+	// save the counts with the batch, written to a temporary file first so readers never see a partial file
+	void Store(const char *fn)
+	{
+		char *tmp = new char[strlen(fn) + 10];
+		NULL_CHECK(tmp);
+		sprintf(tmp, "%s.tmp", fn);
+		FILE *f = fopen(tmp, "wb");
+		bool written = f && fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(cells, sizeof(uint32), header.count, f) == header.count;
+		if (f && fclose(f))
+			written = false;
+		if (written && !rename(tmp, fn))
+			printf("\nSaved the counts of %llu batches to %s", (unsigned long long)header.numBatch, fn);
+		else
+		{
+			printf("\n*** Cannot save the counts to %s", fn);
+			remove(tmp);
+		}
+		delete[] tmp;
+	}
+};
+
+// The samples that carry each rare SNP, that is do not have genotype 0 (-sparse). A combination whose last SNP
+// is rare is counted from the table of its other SNPs, counted once for all the SNPs that follow them, by moving
+// each carrier of the rare SNP out of the genotype 0 cell, so its cost grows with the carriers, not the samples.
+// Each carrier is its sample index in its class shifted left by 2, with its genotype in the low bits.
+class CarrierList
+{
+public:
+	bool *rare;      // SNPs kept as carrier lists
+	uint64 *begin;   // [2 * v] first case carrier of SNP v, [2 * v + 1] its first control carrier, [2 * v + 2] the end
+	uint32 *carrier;
+	varIdx numRare;
+	uint64 numCarrier;
+
+	CarrierList()
+	{
+		memset(this, 0, sizeof(CarrierList));
+	}
+
+	~CarrierList()
+	{
+		delete[] rare;
+		delete[] begin;
+		delete[] carrier;
+	}
+
+	// keep the SNPs whose alternate allele frequency over the cases and controls is below maf
+	void Build(Dataset *d, double maf)
+	{
+		rare = new bool[d->numVariable];
+		NULL_CHECK(rare);
+		begin = new uint64[2 * (uint64)d->numVariable + 1];
+		NULL_CHECK(begin);
+
+		for (varIdx v = 0; v < d->numVariable; v++)
+		{
+			uint8 *caseByte = (uint8 *)d->GetVarCase(v, 0);
+			uint8 *ctrlByte = (uint8 *)d->GetVarCtrl(v, 0);
+			uint64 alleles = 0;
+			uint64 carriers = 0;
+			for (sampleIdx i = 0; i < d->numCase; i++)
+			{
+				alleles += caseByte[i];
+				carriers += caseByte[i] != 0;
+			}
+			for (sampleIdx i = 0; i < d->numCtrl; i++)
+			{
+				alleles += ctrlByte[i];
+				carriers += ctrlByte[i] != 0;
+			}
+			rare[v] = alleles < maf * 2 * d->numSample;
+			if (rare[v])
+			{
+				numRare++;
+				numCarrier += carriers;
+			}
+		}
+
+		carrier = new uint32[numCarrier ? numCarrier : 1];
+		NULL_CHECK(carrier);
+		uint64 c = 0;
+		for (varIdx v = 0; v < d->numVariable; v++)
+		{
+			uint8 *caseByte = (uint8 *)d->GetVarCase(v, 0);
+			uint8 *ctrlByte = (uint8 *)d->GetVarCtrl(v, 0);
+			begin[2 * (uint64)v] = c;
+			if (rare[v])
+				for (sampleIdx i = 0; i < d->numCase; i++)
+					if (caseByte[i])
+						carrier[c++] = ((uint32)i << 2) | caseByte[i];
+			begin[2 * (uint64)v + 1] = c;
+			if (rare[v])
+				for (sampleIdx i = 0; i < d->numCtrl; i++)
+					if (ctrlByte[i])
+						carrier[c++] = ((uint32)i << 2) | ctrlByte[i];
+		}
+		begin[2 * (uint64)d->numVariable] = c;
+
+		printf("\n%u of %u SNPs kept as lists of %llu carriers (-sparse %f)", (uint32)numRare, (uint32)d->numVariable, (unsigned long long)numCarrier, maf);
+	}
+};
+
+struct ThreadData
+{
+	void *epiStat; // epi class
+	uint32 id; // thread index
+};
+
+struct OutputRecord
+{
+	double value;
+	varIdx idx[MAX_ORDER];
+	uint32 metric; // OUT_XXX
+};
+
+// Queue from one compute thread (producer) to the writer thread (consumer), without locks
+struct OutputRing
+{
+	uint64 head;   // records pushed, written by the compute thread only
+	char pad0[56]; // keep head and tail on separate cache lines
+	uint64 tail;   // records written out, written by the writer thread only
+	char pad1[56];
+	OutputRecord *records;
+};
+
+// A reported combination of a -sort run, kept in binary until the merge formats it
+struct SortRecord
+{
+	double value;
+	varIdx idx[MAX_ORDER];
+};
+
+// Records of one output of one order handed to the caller of a streamed run instead of a thread file
+struct StreamBatch
+{
+	uint32 order;
+	uint32 metric; // OUT_XXX
+	uint32 numRecord;
+	double *value;
+	varIdx *idx;   // order + 1 variables of each record, indices of OutputStream::names
+	StreamBatch *next;
+};
+
+// A thread file and its formatted text not written yet
+struct OutputSink
+{
+	FILE *file;
+	GzWriter *gz;
+	char *text;
+	size_t length;
+	StreamBatch *batch; // records not handed to the stream yet
+
+	// -sort: the records of the current run, and the file of the runs sorted so far
+	SortRecord *records;
+	SortRecord *scratch; // buffer of the merge sort
+	uint64 numRecord;
+	FILE *runFile;
+	uint64 *runEnd;      // records in the run file at the end of each run
+	uint32 numRun;
+	uint32 maxRun;
+};
+
+// v in millionths, rounded as printf("%f") writes it. Values whose seventh decimal is too close to a tie for a
+// double multiplication to round them like printf are read back from their text.
+long long Printed(double v)
+{
+	double scaled = v * 1000000.0;
+	double frac = fabs(scaled - floor(scaled));
+	if (fabs(frac - 0.5) < 1e-4)
+	{
+		char text[64];
+		sprintf(text, "%f", v);
+		scaled = strtod(text, NULL) * 1000000.0;
+	}
+	return llround(scaled);
+}
+
+// Order of a sorted output: larger values as printed first, ties by the bytes of the names joined by commas,
+// larger first (as sort -g -r on the written rows)
+struct RecordOrder
+{
+	char **names;
+	uint32 order;
+
+	// a goes before b
+	bool Before(const SortRecord &a, const SortRecord &b) const
+	{
+		if (a.value != b.value)
+		{
+			long long x = Printed(a.value);
+			long long y = Printed(b.value);
+			if (x != y)
+				return x > y;
+			// "-0.000000" sorts after "0.000000" in the last resort comparison of the rows
+			if (!x && signbit(a.value) != signbit(b.value))
+				return signbit(b.value);
+		}
+
+		uint32 i = 0;
+		uint32 j = 0;
+		const char *p = names[a.idx[0]];
+		const char *q = names[b.idx[0]];
+		while (true)
+		{
+			unsigned char c, d;
+			if (*p)
+				c = *p++;
+			else if (i < order)
+			{
+				c = ',';
+				p = names[a.idx[++i]];
+			}
+			else
+				c = 0;
+
+			if (*q)
+				d = *q++;
+			else if (j < order)
+			{
+				d = ',';
+				q = names[b.idx[++j]];
+			}
+			else
+				d = 0;
+
+			if (c != d)
+				return c > d;
+			if (!c)
+				return false;
+		}
+	}
+};
+
+int CompareDecreasing(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x < y) - (x > y);
+}
+
+// Stable bottom-up merge sort of n records, scratch holds n records
+void SortRecords(SortRecord *records, SortRecord *scratch, uint64 n, const RecordOrder &ro)
+{
+	// insertion sort of blocks of 32 records
+	for (uint64 b = 0; b < n; b += 32)
+	{
+		uint64 e = (b + 32 < n) ? b + 32 : n;
+		for (uint64 i = b + 1; i < e; i++)
+		{
+			SortRecord r = records[i];
+			uint64 k = i;
+			for (; k > b && ro.Before(r, records[k - 1]); k--)
+				records[k] = records[k - 1];
+			records[k] = r;
+		}
+	}
+
+	SortRecord *from = records;
+	SortRecord *to = scratch;
+	for (uint64 width = 32; width < n; width *= 2)
+	{
+		for (uint64 lo = 0; lo < n; lo += 2 * width)
+		{
+			uint64 mid = (lo + width < n) ? lo + width : n;
+			uint64 hi = (lo + 2 * width < n) ? lo + 2 * width : n;
+			uint64 i = lo;
+			uint64 j = mid;
+			uint64 k = lo;
+			while (i < mid && j < hi)
+				to[k++] = ro.Before(from[j], from[i]) ? from[j++] : from[i++];
+			while (i < mid)
+				to[k++] = from[i++];
+			while (j < hi)
+				to[k++] = from[j++];
+		}
+		SortRecord *t = from;
+		from = to;
+		to = t;
+	}
+	if (from != records)
+		memcpy(records, from, n * sizeof(SortRecord));
+}
+
+// Write v as printf("%f") does, without stdio. Values whose seventh decimal is too close to a tie
+// for a double multiplication to round them like printf, and values that round to 1000 or more, go through sprintf.
+uint32 FormatValue(char *text, double v)
+{
+	double a = fabs(v);
+	if (!(a < 1000))
+		return sprintf(text, "%f", v);
+	double scaled = a * 1000000.0;
+	double whole = floor(scaled);
+	double frac = scaled - whole;
+	if (fabs(frac - 0.5) < 1e-4)
+		return sprintf(text, "%f", v);
+
+	uint64 n = (uint64)whole + (frac > 0.5 ? 1 : 0);
+	uint32 integer = (uint32)(n / 1000000);
+	uint32 decimals = (uint32)(n % 1000000);
+	if (integer >= 1000)
+		return sprintf(text, "%f", v);
+
+	char *t = text;
+	if (signbit(v))
+		*t++ = '-';
+	if (integer >= 100)
+		*t++ = '0' + integer / 100;
+	if (integer >= 10)
+		*t++ = '0' + (integer / 10) % 10;
+	*t++ = '0' + integer % 10;
+	*t++ = '.';
+	for (int32 i = 5; i >= 0; i--)
+	{
+		t[i] = '0' + decimals % 10;
+		decimals /= 10;
+	}
+	return (uint32)(t + 6 - text);
+}
+
+// Bounded queue of the batches of a run, from its writer threads to a caller that reads them as they come.
+// A writer waits while the queue is full, and its compute threads then wait on their rings.
+class OutputStream
+{
+	pthread_mutex_t lock;
+	pthread_cond_t changed; // a batch was queued or taken, or the stream finished or closed
+	StreamBatch *first;
+	StreamBatch *last;
+	uint32 numQueued;
+	bool finished; // no batch will be queued anymore
+	bool closed;   // the caller stopped reading, batches are dropped
+
+public:
+	char **names;      // names of the variables in the run order, then their aliases (-collapse)
+	varIdx numName;
+	varIdx *aliasBase; // index in names of the first alias of each variable, NULL without aliases
+
+	OutputStream()
+	{
+		pthread_mutex_init(&lock, NULL);
+		pthread_cond_init(&changed, NULL);
+		first = last = NULL;
+		numQueued = 0;
+		finished = closed = false;
+		names = NULL;
+		numName = 0;
+		aliasBase = NULL;
+	}
+
+	~OutputStream()
+	{
+		Close();
+		for (varIdx i = 0; i < numName; i++)
+			delete[] names[i];
+		delete[] names;
+		delete[] aliasBase;
+		pthread_cond_destroy(&changed);
+		pthread_mutex_destroy(&lock);
+	}
+
+	// copy the names of a run before its first batch, they are freed at the end of the run
+	void SetNames(char **n, char ***aliases, varIdx numVariable)
+	{
+		if (names)
+			return;
+		numName = numVariable;
+		if (aliases)
+		{
+			aliasBase = new varIdx[numVariable];
+			NULL_CHECK(aliasBase);
+			for (varIdx v = 0; v < numVariable; v++)
+			{
+				aliasBase[v] = numName;
+				for (uint32 a = 0; aliases[v] && aliases[v][a]; a++)
+					numName++;
+			}
+		}
+		names = new char *[numName];
+		NULL_CHECK(names);
+		for (varIdx v = 0; v < numVariable; v++)
+		{
+			names[v] = new char[strlen(n[v]) + 1];
+			NULL_CHECK(names[v]);
+			strcpy(names[v], n[v]);
+			for (uint32 a = 0; aliases && aliases[v] && aliases[v][a]; a++)
+			{
+				char *&name = names[aliasBase[v] + a];
+				name = new char[strlen(aliases[v][a]) + 1];
+				NULL_CHECK(name);
+				strcpy(name, aliases[v][a]);
+			}
+		}
+	}
+
+	static StreamBatch *NewBatch(uint32 order, uint32 metric)
+	{
+		StreamBatch *batch = new StreamBatch;
+		NULL_CHECK(batch);
+		batch->order = order;
+		batch->metric = metric;
+		batch->numRecord = 0;
+		batch->value = new double[STREAM_BATCH];
+		batch->idx = new varIdx[STREAM_BATCH * (order + 1)];
+		NULL_CHECK(batch->value);
+		NULL_CHECK(batch->idx);
+		batch->next = NULL;
+		return batch;
+	}
+
+	static void FreeBatch(StreamBatch *batch)
+	{
+		delete[] batch->value;
+		delete[] batch->idx;
+		delete batch;
+	}
+
+	// queue a batch, waiting while STREAM_DEPTH batches are queued
+	void Put(StreamBatch *batch)
+	{
+		pthread_mutex_lock(&lock);
+		while (numQueued >= STREAM_DEPTH && !closed)
+			pthread_cond_wait(&changed, &lock);
+		if (closed)
+		{
+			pthread_mutex_unlock(&lock);
+			FreeBatch(batch);
+			return;
+		}
+		if (last)
+			last->next = batch;
+		else
+			first = batch;
+		last = batch;
+		numQueued++;
+		pthread_cond_broadcast(&changed);
+		pthread_mutex_unlock(&lock);
+	}
+
+	// the next batch, waiting for one, or NULL once the stream has finished and is empty (freed by the caller)
+	StreamBatch *Get()
+	{
+		pthread_mutex_lock(&lock);
+		while (!first && !finished && !closed)
+			pthread_cond_wait(&changed, &lock);
+		StreamBatch *batch = closed ? NULL : first;
+		if (batch)
+		{
+			first = batch->next;
+			if (!first)
+				last = NULL;
+			numQueued--;
+			pthread_cond_broadcast(&changed);
+		}
+		pthread_mutex_unlock(&lock);
+		return batch;
+	}
+
+	// called once the run has returned
+	void Finish()
+	{
+		pthread_mutex_lock(&lock);
+		finished = true;
+		pthread_cond_broadcast(&changed);
+		pthread_mutex_unlock(&lock);
+	}
+
+	// called by the caller to stop reading: the queued batches and the later ones are dropped
+	void Close()
+	{
+		pthread_mutex_lock(&lock);
+		closed = true;
+		while (first)
+		{
+			StreamBatch *batch = first;
+			first = batch->next;
+			FreeBatch(batch);
+		}
+		last = NULL;
+		numQueued = 0;
+		pthread_cond_broadcast(&changed);
+		pthread_mutex_unlock(&lock);
+	}
+};
+
+void *OutputThread(void *w);
+void *SpillThread(void *s);
+void *MergeThread(void *p);
+
+class OutputWriter;
+
+// Sort the last run of a sink in a thread of its own
+struct SpillData
+{
+	OutputWriter *writer;
+	OutputSink *sink;
+};
+
+// A run of a thread file read by a part of the merge
+struct RunReader
+{
+	OutputSink *sink;
+	uint64 next;         // next record of the run file to read
+	uint64 end;          // end of the part in the run file
+	SortRecord *buffer;
+	uint32 count;
+	uint32 pos;
+};
+
+// The records of a value range merged from every run into one piece of the output
+struct MergePart
+{
+	OutputWriter *writer;
+	RunReader *readers;
+	uint32 numRun;
+	OutputSink sink;
+};
+
+// Formats the reported combinations of an order and writes them to the thread files in large blocks,
+// in a thread of its own so the compute threads never wait for the disk (without pthreads it writes in Push).
+// With -sort the thread files hold sorted runs of binary records, merged into the output file by Merge.
+class OutputWriter
+{
+	uint32 order;
+	uint32 numThreads;
+	bool gz;
+	bool sort;
+	const char *output;
+	char **names;
+	char ***aliases;    // other names of each variable (-collapse), NULL for none
+	uint32 *nameLength; // strlen of each name
+	OutputRing *rings;
+	OutputSink *sinks; // [thread * NUM_OUT + output]
+	RecordOrder recordOrder;
+	OutputStream *stream; // the batches replace the thread files in a streamed run, NULL for files
+	uint64 runSize;    // records sorted in memory before a run is written to the run file
+	uint32 bufferSize; // records read at once from a run by the merge
+	volatile bool done;
+	pthread_t thread;
+
+	void Flush(OutputSink &sink)
+	{
+		if (!sink.length)
+			return;
+		if (sink.gz ? GzWriter_write(sink.gz, sink.text, sink.length) != 0
+					: fwrite(sink.text, 1, sink.length, sink.file) != sink.length)
+			ERROR("Cannot write output file");
+		sink.length = 0;
+	}
+
+	// the next combination of the names of the variables of idx, false after the last one
+	bool NextAlias(const varIdx *idx, uint32 *member)
+	{
+		if (!aliases)
+			return false;
+		for (uint32 o = order + 1; o-- > 0;)
+		{
+			char **a = aliases[idx[o]];
+			if (a && a[member[o]])
+			{
+				member[o]++;
+				return true;
+			}
+			member[o] = 0;
+		}
+		return false;
+	}
+
+	// with -collapse a line for every combination of the names of the variables
+	void Write(OutputSink &sink, double value, const varIdx *idx)
+	{
+		uint32 member[MAX_ORDER] = { 0 };
+		do
+		{
+			const char *name[MAX_ORDER];
+			uint32 length[MAX_ORDER];
+			size_t need = 320; // the longest %f of a double, and the newline
+			for (uint32 o = 0; o <= order; o++)
+			{
+				name[o] = member[o] ? aliases[idx[o]][member[o] - 1] : names[idx[o]];
+				length[o] = member[o] ? (uint32)strlen(name[o]) : nameLength[idx[o]];
+				need += length[o] + 1;
+			}
+			if (sink.length + need > OUT_BUFFER)
+				Flush(sink);
+
+			char *text = sink.text + sink.length;
+			text += FormatValue(text, value);
+			for (uint32 o = 0; o <= order; o++)
+			{
+				*text++ = ',';
+				memcpy(text, name[o], length[o]);
+				text += length[o];
+			}
+			*text++ = '\n';
+			sink.length = text - sink.text;
+		} while (NextAlias(idx, member));
+	}
+
+	// add a record to the batch of its sink, with -collapse once for every combination of the names
+	void Batch(OutputSink &sink, const OutputRecord &r)
+	{
+		uint32 member[MAX_ORDER] = { 0 };
+		do
+		{
+			if (!sink.batch)
+				sink.batch = OutputStream::NewBatch(order, r.metric);
+			StreamBatch *batch = sink.batch;
+			varIdx *idx = batch->idx + (uint64)batch->numRecord * (order + 1);
+			batch->value[batch->numRecord] = r.value;
+			for (uint32 o = 0; o <= order; o++)
+				idx[o] = member[o] ? stream->aliasBase[r.idx[o]] + member[o] - 1 : r.idx[o];
+			if (++batch->numRecord == STREAM_BATCH)
+			{
+				stream->Put(batch);
+				sink.batch = NULL;
+			}
+		} while (NextAlias(r.idx, member));
+	}
+
+	void Format(uint32 t, const OutputRecord &r)
+	{
+		OutputSink &sink = sinks[t * NUM_OUT + r.metric];
+		if (stream)
+		{
+			Batch(sink, r);
+			return;
+		}
+		if (!sort)
+		{
+			Write(sink, r.value, r.idx);
+			return;
+		}
+
+		SortRecord &s = sink.records[sink.numRecord++];
+		s.value = r.value;
+		for (uint32 o = 0; o < MAX_ORDER; o++)
+			s.idx[o] = (o <= order) ? r.idx[o] : 0;
+		if (sink.numRecord == runSize)
+			Spill(sink);
+	}
+
+	void OpenOutput(OutputSink &sink, const char *fn, const char *mode)
+	{
+		memset(&sink, 0, sizeof(OutputSink));
+		if (gz)
+		{
+			sink.gz = GzWriter_new(fn, mode);
+			NULL_CHECK(sink.gz);
+		}
+		else
+		{
+			sink.file = fopen(fn, mode);
+			NULL_CHECK(sink.file);
+		}
+		sink.text = new char[OUT_BUFFER];
+		NULL_CHECK(sink.text);
+	}
+
+	void CloseOutput(OutputSink &sink)
+	{
+		Flush(sink);
+		if (sink.gz && GzWriter_close(sink.gz))
+			ERROR("Cannot write output file");
+		if (sink.file && fclose(sink.file))
+			ERROR("Cannot write output file");
+		delete[] sink.text;
+		sink.gz = NULL;
+		sink.file = NULL;
+		sink.text = NULL;
+	}
+
+	// append a file to the output file and delete it
+	void Append(const char *to, const char *fn)
+	{
+		FILE *in = fopen(fn, "rb");
+		FILE *out = fopen(to, "ab");
+		NULL_CHECK(in);
+		NULL_CHECK(out);
+		char *buffer = new char[OUT_BUFFER];
+		NULL_CHECK(buffer);
+		size_t n;
+		while ((n = fread(buffer, 1, OUT_BUFFER, in)) > 0)
+			if (fwrite(buffer, 1, n, out) != n)
+				ERROR("Cannot merge output files");
+		if (ferror(in) || fclose(out))
+			ERROR("Cannot merge output files");
+		fclose(in);
+		delete[] buffer;
+		remove(fn);
+	}
+
+	void ReadRecords(OutputSink &sink, uint64 first, uint64 count, SortRecord *to)
+	{
+#ifdef _MSC_VER
+		_fseeki64(sink.runFile, first * sizeof(SortRecord), SEEK_SET);
+		if (fread(to, sizeof(SortRecord), count, sink.runFile) != count)
+			ERROR("Cannot read run file");
+#else
+		// pread keeps no file position, so the parts of the merge share the run file
+		char *p = (char *)to;
+		uint64 bytes = count * sizeof(SortRecord);
+		uint64 offset = first * sizeof(SortRecord);
+		while (bytes)
+		{
+			ssize_t n = pread(fileno(sink.runFile), p, bytes, offset);
+			if (n <= 0)
+				ERROR("Cannot read run file");
+			p += n;
+			bytes -= n;
+			offset += n;
+		}
+#endif
+	}
+
+	// number of records of a run (sorted by decreasing value) with a value above v
+	uint64 CountAbove(OutputSink &sink, uint64 begin, uint64 end, double v)
+	{
+		SortRecord r;
+		uint64 lo = begin;
+		uint64 hi = end;
+		while (lo < hi)
+		{
+			uint64 mid = lo + (hi - lo) / 2;
+			ReadRecords(sink, mid, 1, &r);
+			if (r.value > v)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+
+	bool Refill(RunReader &reader)
+	{
+		if (reader.next == reader.end)
+			return false;
+		uint64 n = reader.end - reader.next;
+		reader.count = (uint32)(n < bufferSize ? n : bufferSize);
+		reader.pos = 0;
+		ReadRecords(*reader.sink, reader.next, reader.count, reader.buffer);
+		reader.next += reader.count;
+		return true;
+	}
+
+	void SiftDown(uint32 *heap, uint32 numHeap, uint32 i, RunReader *readers)
+	{
+		while (true)
+		{
+			uint32 c = 2 * i + 1;
+			if (c >= numHeap)
+				return;
+			RunReader *child = &readers[heap[c]];
+			if (c + 1 < numHeap)
+			{
+				RunReader *right = &readers[heap[c + 1]];
+				if (recordOrder.Before(right->buffer[right->pos], child->buffer[child->pos]))
+				{
+					c++;
+					child = right;
+				}
+			}
+			RunReader *parent = &readers[heap[i]];
+			if (!recordOrder.Before(child->buffer[child->pos], parent->buffer[parent->pos]))
+				return;
+			uint32 h = heap[i];
+			heap[i] = heap[c];
+			heap[c] = h;
+			i = c;
+		}
+	}
+
+public:
+	OutputWriter()
+	{
+		sinks = NULL;
+	}
+
+	~OutputWriter()
+	{
+		if (!sinks)
+			return;
+		for (uint32 i = 0; i < numThreads * NUM_OUT; i++)
+		{
+			if (sinks[i].runFile)
+				fclose(sinks[i].runFile);
+			delete[] sinks[i].runEnd;
+		}
+		delete[] sinks;
+		delete[] nameLength;
+	}
+
+	void Open(ARGS &args, uint32 o, char **n, char ***a, varIdx numVariable, OutputStream *s)
+	{
+		order = o;
+		numThreads = args.numThreads;
+		gz = args.gz;
+		sort = args.sort && !s;
+		stream = s;
+		if (stream)
+			stream->SetNames(n, a, numVariable);
+		output = args.output;
+		names = n;
+		aliases = a;
+		done = false;
+		recordOrder.names = names;
+		recordOrder.order = order;
+
+		nameLength = new uint32[numVariable];
+		NULL_CHECK(nameLength);
+		for (varIdx v = 0; v < numVariable; v++)
+			nameLength[v] = (uint32)strlen(names[v]);
+
+		rings = new OutputRing[numThreads];
+		sinks = new OutputSink[numThreads * NUM_OUT];
+		NULL_CHECK(rings);
+		NULL_CHECK(sinks);
+		memset(sinks, 0, numThreads * NUM_OUT * sizeof(OutputSink));
+
+		// the records and the merge sort buffer of every sink share SORT_MEMORY
+		uint32 numSink = 0;
+		for (uint32 m = 0; m < NUM_OUT; m++)
+			numSink += args.Prints(m, order) ? numThreads : 0;
+		runSize = numSink ? SORT_MEMORY / (2 * sizeof(SortRecord) * numSink) : 0;
+		if (runSize < SORT_MIN_RUN)
+			runSize = SORT_MIN_RUN;
+
+		char* fn = new char[strlen(args.output) + 30];
+		NULL_CHECK(fn);
+		for (uint32 t = 0; t < numThreads; t++)
+		{
+			rings[t].head = rings[t].tail = 0;
+			rings[t].records = new OutputRecord[RING_SIZE];
+			NULL_CHECK(rings[t].records);
+
+			for (uint32 m = 0; m < NUM_OUT; m++)
+			{
+				if (!args.Prints(m, order) || stream)
+					continue;
+				OutputSink &sink = sinks[t * NUM_OUT + m];
+				if (!sort)
+				{
+					sprintf(fn, "%s.%s.%u.%u.%s", args.output, outName[m], order, t, gz ? "csv.gz" : "csv");
+					OpenOutput(sink, fn, "wb");
+					continue;
+				}
+				sprintf(fn, "%s.%s.%u.%u.run", args.output, outName[m], order, t);
+				sink.runFile = fopen(fn, "w+b");
+				NULL_CHECK(sink.runFile);
+				sink.records = new SortRecord[runSize];
+				sink.scratch = new SortRecord[runSize];
+				NULL_CHECK(sink.records);
+				NULL_CHECK(sink.scratch);
+			}
+		}
+		delete[]fn;
+
+#ifndef _MSC_VER
+		pthread_create(&thread, NULL, OutputThread, this);
+#endif
+	}
+
+	// queue a combination of thread t, waiting only while its ring is full
+	void Push(uint32 t, uint32 metric, double value, varIdx *idx)
+	{
+		OutputRecord r;
+		r.value = value;
+		r.metric = metric;
+		for (uint32 o = 0; o <= order; o++)
+			r.idx[o] = idx[o];
+#ifdef _MSC_VER
+		Format(t, r);
+#else
+		OutputRing &ring = rings[t];
+		uint64 head = ring.head;
+		while (head - __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) >= RING_SIZE)
+			usleep(50);
+		ring.records[head & (RING_SIZE - 1)] = r;
+		__atomic_store_n(&ring.head, head + 1, __ATOMIC_RELEASE);
+#endif
+	}
+
+	// the writer thread: format the queued records until Close and the rings are empty
+	void Drain()
+	{
+#ifndef _MSC_VER
+		while (true)
+		{
+			bool finished = __atomic_load_n(&done, __ATOMIC_ACQUIRE);
+			uint64 moved = 0;
+			for (uint32 t = 0; t < numThreads; t++)
+			{
+				OutputRing &ring = rings[t];
+				uint64 head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+				for (uint64 i = ring.tail; i < head; i++)
+					Format(t, ring.records[i & (RING_SIZE - 1)]);
+				moved += head - ring.tail;
+				__atomic_store_n(&ring.tail, head, __ATOMIC_RELEASE);
+			}
+			if (!moved)
+			{
+				if (finished)
+					break;
+				usleep(200);
+			}
+		}
+#endif
+	}
+
+	// sort the records of the current run of a sink and append them to its run file
+	void Spill(OutputSink &sink)
+	{
+		if (!sink.numRecord)
+			return;
+		SortRecords(sink.records, sink.scratch, sink.numRecord, recordOrder);
+		if (fwrite(sink.records, sizeof(SortRecord), sink.numRecord, sink.runFile) != sink.numRecord)
+			ERROR("Cannot write run file");
+
+		if (sink.numRun == sink.maxRun)
+		{
+			sink.maxRun = sink.maxRun ? sink.maxRun * 2 : 16;
+			uint64 *runEnd = new uint64[sink.maxRun];
+			NULL_CHECK(runEnd);
+			if (sink.numRun)
+				memcpy(runEnd, sink.runEnd, sink.numRun * sizeof(uint64));
+			delete[] sink.runEnd;
+			sink.runEnd = runEnd;
+		}
+		sink.runEnd[sink.numRun] = (sink.numRun ? sink.runEnd[sink.numRun - 1] : 0) + sink.numRecord;
+		sink.numRun++;
+		sink.numRecord = 0;
+	}
+
+	// called once the compute threads have finished
+	void Close()
+	{
+#ifndef _MSC_VER
+		__atomic_store_n(&done, true, __ATOMIC_RELEASE);
+		pthread_join(thread, NULL);
+#endif
+		for (uint32 i = 0; i < numThreads * NUM_OUT; i++)
+		{
+			if (sinks[i].text)
+				CloseOutput(sinks[i]);
+			if (sinks[i].batch)
+				stream->Put(sinks[i].batch);
+			sinks[i].batch = NULL;
+		}
+
+		// sort the last run of every sink at the same time
+		if (sort)
+		{
+			pthread_t *threads = new pthread_t[numThreads * NUM_OUT];
+			SpillData *spill = new SpillData[numThreads * NUM_OUT];
+			NULL_CHECK(threads);
+			NULL_CHECK(spill);
+			for (uint32 i = 0; i < numThreads * NUM_OUT; i++)
+			{
+				spill[i].writer = this;
+				spill[i].sink = &sinks[i];
+				if (sinks[i].records)
+					pthread_create(&threads[i], NULL, SpillThread, &spill[i]);
+			}
+			for (uint32 i = 0; i < numThreads * NUM_OUT; i++)
+			{
+				if (!sinks[i].records)
+					continue;
+				pthread_join(threads[i], NULL);
+				if (fflush(sinks[i].runFile))
+					ERROR("Cannot write run file");
+				delete[] sinks[i].records;
+				delete[] sinks[i].scratch;
+				sinks[i].records = sinks[i].scratch = NULL;
+			}
+			delete[] threads;
+			delete[] spill;
+		}
+
+		for (uint32 t = 0; t < numThreads; t++)
+			delete[] rings[t].records;
+		delete[] rings;
+	}
+
+	// write the output file of a metric: the header, then the thread files in thread order, or with -sort
+	// a k-way merge of their runs, split by value into parts that are merged in parallel and then concatenated
+	void Merge(uint32 m)
+	{
+		const char *metric = outName[m];
+		char *fn = new char[strlen(output) + 40];
+		char *part = new char[strlen(output) + 40];
+		NULL_CHECK(fn);
+		NULL_CHECK(part);
+		sprintf(fn, "%s.%s.%u.%s", output, metric, order, gz ? "csv.gz" : "csv");
+		printf("\n>>> merge %s", fn);
+
+		// the header is a gzip member of its own with -gz, gzip members can be concatenated
+		char header[64];
+		int length = sprintf(header, "%s,SNP_A", metric);
+		for (uint32 o = 1; o <= order; o++)
+			length += sprintf(header + length, ",SNP_%c", 'A' + o);
+		header[length++] = '\n';
+		OutputSink headerSink;
+		OpenOutput(headerSink, fn, "wb");
+		memcpy(headerSink.text, header, length);
+		headerSink.length = length;
+		CloseOutput(headerSink);
+
+		if (!sort)
+		{
+			for (uint32 t = 0; t < numThreads; t++)
+			{
+				sprintf(part, "%s.%s.%u.%u.%s", output, metric, order, t, gz ? "csv.gz" : "csv");
+				Append(fn, part);
+			}
+			printf("\n");
+			delete[] fn;
+			delete[] part;
+			return;
+		}
+
+		// every run of every thread of the metric
+		uint32 numRun = 0;
+		uint64 total = 0;
+		for (uint32 t = 0; t < numThreads; t++)
+		{
+			OutputSink &sink = sinks[t * NUM_OUT + m];
+			numRun += sink.numRun;
+			total += sink.numRun ? sink.runEnd[sink.numRun - 1] : 0;
+		}
+		OutputSink **runSink = new OutputSink *[numRun + 1];
+		uint64 *runBegin = new uint64[numRun + 1];
+		uint64 *runEnd = new uint64[numRun + 1];
+		NULL_CHECK(runSink);
+		NULL_CHECK(runBegin);
+		NULL_CHECK(runEnd);
+		uint32 r = 0;
+		for (uint32 t = 0; t < numThreads; t++)
+		{
+			OutputSink &sink = sinks[t * NUM_OUT + m];
+			for (uint32 i = 0; i < sink.numRun; i++, r++)
+			{
+				runSink[r] = &sink;
+				runBegin[r] = i ? sink.runEnd[i - 1] : 0;
+				runEnd[r] = sink.runEnd[i];
+			}
+		}
+
+		// split values at quantiles of a sample of every run, equal values stay in one part
+		uint32 numPart = (uint32)(total / MERGE_MIN_PART);
+		numPart = numPart > numThreads ? numThreads : (numPart ? numPart : 1);
+		double *split = new double[numPart];
+		NULL_CHECK(split);
+		uint32 numSplit = 0;
+		if (numPart > 1)
+		{
+			uint32 numSample = 0;
+			double *sample = new double[numRun * MERGE_SAMPLE];
+			NULL_CHECK(sample);
+			for (r = 0; r < numRun; r++)
+			{
+				for (uint32 s = 0; s < MERGE_SAMPLE; s++)
+				{
+					SortRecord record;
+					ReadRecords(*runSink[r], runBegin[r] + (runEnd[r] - runBegin[r]) * s / MERGE_SAMPLE, 1, &record);
+					sample[numSample++] = record.value;
+				}
+			}
+			qsort(sample, numSample, sizeof(double), CompareDecreasing);
+			for (uint32 p = 1; p < numPart; p++)
+			{
+				double v = sample[(uint64)numSample * p / numPart];
+				if (!numSplit || v < split[numSplit - 1])
+					split[numSplit++] = v;
+			}
+			numPart = numSplit + 1;
+			delete[] sample;
+		}
+
+		// every part reads its range of every run with buffers that share MERGE_MEMORY
+		uint64 buffer = MERGE_MEMORY / ((uint64)(numRun ? numRun : 1) * numPart * sizeof(SortRecord));
+		bufferSize = (uint32)(buffer < MERGE_MIN_BUFFER ? MERGE_MIN_BUFFER : (buffer > MERGE_MAX_BUFFER ? MERGE_MAX_BUFFER : buffer));
+
+		MergePart *parts = new MergePart[numPart];
+		pthread_t *threads = new pthread_t[numPart];
+		NULL_CHECK(parts);
+		NULL_CHECK(threads);
+		for (uint32 p = 0; p < numPart; p++)
+		{
+			parts[p].writer = this;
+			parts[p].numRun = numRun;
+			parts[p].readers = new RunReader[numRun + 1];
+			NULL_CHECK(parts[p].readers);
+			for (r = 0; r < numRun; r++)
+			{
+				RunReader &reader = parts[p].readers[r];
+				reader.sink = runSink[r];
+				reader.next = p ? CountAbove(*runSink[r], runBegin[r], runEnd[r], split[p - 1]) : runBegin[r];
+				reader.end = (p + 1 < numPart) ? CountAbove(*runSink[r], runBegin[r], runEnd[r], split[p]) : runEnd[r];
+				reader.buffer = new SortRecord[bufferSize];
+				NULL_CHECK(reader.buffer);
+			}
+
+			// the first part is written straight after the header
+			if (p)
+				sprintf(part, "%s.%s.%u.part%u.%s", output, metric, order, p, gz ? "csv.gz" : "csv");
+			OpenOutput(parts[p].sink, p ? part : fn, p ? "wb" : "ab");
+			pthread_create(&threads[p], NULL, MergeThread, &parts[p]);
+		}
+		for (uint32 p = 0; p < numPart; p++)
+			pthread_join(threads[p], NULL);
+
+		for (uint32 p = 0; p < numPart; p++)
+		{
+			CloseOutput(parts[p].sink);
+			for (r = 0; r < numRun; r++)
+				delete[] parts[p].readers[r].buffer;
+			delete[] parts[p].readers;
+			if (!p)
+				continue;
+			sprintf(part, "%s.%s.%u.part%u.%s", output, metric, order, p, gz ? "csv.gz" : "csv");
+			Append(fn, part);
+		}
+		printf(" (%llu records, %u runs, %u parts)\n", (unsigned long long)total, numRun, numPart);
+
+		for (uint32 t = 0; t < numThreads; t++)
+		{
+			OutputSink &sink = sinks[t * NUM_OUT + m];
+			fclose(sink.runFile);
+			sink.runFile = NULL;
+			sprintf(part, "%s.%s.%u.%u.run", output, metric, order, t);
+			remove(part);
+		}
+
+		delete[] parts;
+		delete[] threads;
+		delete[] split;
+		delete[] runSink;
+		delete[] runBegin;
+		delete[] runEnd;
+		delete[] fn;
+		delete[] part;
+	}
+
+	// a part of the merge: a heap of the runs by their next record
+	void MergeRuns(MergePart &part)
+	{
+		uint32 numHeap = 0;
+		uint32 *heap = new uint32[part.numRun + 1];
+		NULL_CHECK(heap);
+		for (uint32 i = 0; i < part.numRun; i++)
+			if (Refill(part.readers[i]))
+				heap[numHeap++] = i;
+		for (uint32 i = numHeap / 2; i > 0; i--)
+			SiftDown(heap, numHeap, i - 1, part.readers);
+
+		while (numHeap)
+		{
+			RunReader &reader = part.readers[heap[0]];
+			SortRecord &record = reader.buffer[reader.pos];
+			Write(part.sink, record.value, record.idx);
+			if (++reader.pos == reader.count && !Refill(reader))
+				heap[0] = heap[--numHeap];
+			SiftDown(heap, numHeap, 0, part.readers);
+		}
+		delete[] heap;
+	}
+};
+
+void *OutputThread(void *w)
+{
+	((OutputWriter *)w)->Drain();
+	return NULL;
+}
+
+void *SpillThread(void *s)
+{
+	SpillData *sd = (SpillData *)s;
+	sd->writer->Spill(*sd->sink);
+	return NULL;
+}
+
+void *MergeThread(void *p)
+{
+	MergePart *part = (MergePart *)p;
+	part->writer->MergeRuns(*part);
+	return NULL;
+}
+
+// A SNP of -annot with its sort keys: blocks its combinations stay in, then blocks they must cross, then position
+struct AnnotatedVariable
+{
+	varIdx var;
+	const char *key[3];
+	uint64 pos;
+};
+
+int CompareAnnotated(const void *x, const void *y)
+{
+	const AnnotatedVariable *a = (const AnnotatedVariable *)x;
+	const AnnotatedVariable *b = (const AnnotatedVariable *)y;
+	for (uint32 k = 0; k < 3; k++)
+	{
+		int c = strcmp(a->key[k], b->key[k]);
+		if (c)
+			return c;
+	}
+	if (a->pos != b->pos) return a->pos < b->pos ? -1 : 1;
+	return a->var < b->var ? -1 : (a->var > b->var);
+}
+
+// First positions handed to the threads of a fused traversal (-fused), from the last one down
+struct FusedQueue
+{
+	pthread_mutex_t lock;
+	varIdx next; // positions below next are not handed out yet
+	bool *done;  // every combination starting at the position has been processed
+};
+
+// The threads of an order that split the samples (-split): each one counts its share of the words of a batch of
+// combinations into partial tables, then sums the partial tables of its share of the batch and reports them.
+struct SampleSplit
+{
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint32 waiting;    // threads at the barrier
+	uint32 generation; // barriers passed
+	bool stopped;      // set by thread 0 before the second barrier of a batch, read by every thread after it
+	uint32 entry;      // cells of a table of the order, in the order of cti
+	sampleIdx *partialCase; // [thread][combination of the batch][entry]
+	sampleIdx *partialCtrl;
+};
+
+struct NamedVariable
+{
+	const char *name;
+	varIdx var;
+};
+
+int CompareNamed(const void *x, const void *y)
+{
+	return strcmp(((const NamedVariable *)x)->name, ((const NamedVariable *)y)->name);
+}
+
+struct WorkItem
+{
+	double work;
+	varIdx first;
+};
+
+int CompareWork(const void *x, const void *y)
+{
+	const WorkItem *a = (const WorkItem *)x;
+	const WorkItem *b = (const WorkItem *)y;
+	if (a->work != b->work) return a->work > b->work ? -1 : 1;
+	return a->first < b->first ? -1 : (a->first > b->first);
+}
+
+class EpiStat
+{
+public:
+	Dataset *dataset;
+	PurityTable *purity; // saved purities used to compute IG
+	Result *results;     // best IG of each SNP, shared by the threads (-bestIG)
+	Result *previous;    // best IG of the SNPs of the state, by run position (-resume), NULL without
+	CountTable *counts;  // genotype counts of all the sample batches, the purities of SNPs and pairs are taken from (-counts), NULL without
+	CarrierList *carriers; // samples carrying each rare SNP (-sparse), NULL without
+	PurityTable *metricTable[NUM_METRIC]; // saved values of the other metrics used to compute their gain
+	Result *metricResults[NUM_METRIC];    // best gain of each SNP for the other metrics (-bestIG:metric)
+	Sketch *sketches;    // distribution of the purity and IG of each thread and order (-sketch), NULL without
+	Placement *placement;
+
+	ARGS args;
+	uint32 threadIdx;
+
+	void *(*threadFunction[4]) (void *);
+
+	// These 4 items must be allocated by each thread separately
+	word *epiCaseWord[3];
+	word *epiCtrlWord[3];
+
+	sampleIdx *contingencyCase;
+	sampleIdx *contingencyCtrl;
+
+	// with binary genotypes (-model dominant or recessive) the samples of each cell of the first o + 1 SNPs are the
+	// masks of epiCaseBit[o], 2 << o consecutive words for each word of samples, and bitCountCase[o] their counts
+	bool bits;
+	word *epiCaseBit[3];
+	word *epiCtrlBit[3];
+	uint32 bitCountCase[3][8];
+	uint32 bitCountCtrl[3][8];
+
+	// table of the first o SNPs of the current combination at [o], counted once for the rare SNPs that follow them (-sparse)
+	sampleIdx prefixCase[MAX_ORDER][64];
+	sampleIdx prefixCtrl[MAX_ORDER][64];
+	bool prefixReady[MAX_ORDER];
+
+	OutputWriter *writer; // formats and writes the reported combinations of the current order
+	OutputWriter *writers[MAX_ORDER]; // writer of each order, kept until its thread files are merged
+	OutputStream *stream; // takes the reported combinations instead of the output files, NULL for files
+	FusedQueue *queue;    // first positions of a fused traversal (-fused), NULL for one pass per order
+	uint32 fusedTop;      // highest order of the fused traversal
+	void *(*fusedFunction) (void *);
+	SampleSplit *split;   // shared by the threads of an order that split the samples (-split), NULL for first positions
+	uint32 splitOrder;    // order index of those threads
+	void *(*splitFunction) (void *);
+
+	volatile bool *cancel; // set by the caller to stop the threads at the next work unit (first SNP)
+	volatile bool *stop;   // set once the run stops with the results so far (-timeBudget or a signal)
+	double deadline;       // wall clock time at which the run stops (-timeBudget), 0 for none
+
+	uint32 node;           // NUMA node of this thread
+	uint64 numCombination; // number of combinations processed by this thread
+	uint64 numPruned;      // number of combinations this thread stopped counting (-early)
+	uint64 numOrder[MAX_ORDER]; // number of combinations of each order processed by this thread
+	uint64 covered[MAX_ORDER];  // number of combinations of each order processed by the run
+
+	bool prune[MAX_ORDER]; // the order counts its combinations in blocks with -early
+	uint32 earlyBlocks;    // blocks of samples of -early
+
+	varIdx *varMap;   // dataset variable at each position of the run (targets first), NULL for the dataset order
+	char **names;     // names of the variables in the run order
+	char ***aliases;  // other names of the variables in the run order (-collapse), NULL for none
+	varIdx numTarget; // combinations start with one of the first numTarget positions (-targets), 0 for all
+	varIdx *nextVar;  // first position that can follow each position in a combination (-annot), NULL for the next one
+	varIdx *endVar;   // end of the positions that can share a combination starting at each position (-annot), NULL for all
+	uint32 *owner;    // thread of each first position, balanced on the work of the order (-annot), NULL for round robin
+	varIdx numOld;    // the first numOld positions hold the SNPs of the state, whose combinations it has (-resume), 0 without
+	varIdx firstNew[MAX_ORDER]; // the last SNP of a combination of each order starts at this position, numOld for the orders not saved
+	double beginTime;
+	double endTime;
+
+	// add the purity or IG (OUT_PURITY or OUT_IG) of a combination of order o to the distributions of the thread
+	void AddSketch(uint32 o, uint32 m, double v)
+	{
+		sketches[(threadIdx * MAX_ORDER + o) * 2 + m].Add(v);
+	}
+
+	void AllocateSketches()
+	{
+		sketches = new Sketch[args.numThreads * MAX_ORDER * 2];
+		NULL_CHECK(sketches);
+		for (uint32 i = 0; i < args.numThreads * MAX_ORDER * 2; i++)
+			sketches[i].Init(i);
+	}
+
+	void FreeSketches()
+	{
+		if (!sketches)
+			return;
+		for (uint32 i = 0; i < args.numThreads * MAX_ORDER * 2; i++)
+			sketches[i].Free();
+		delete[] sketches;
+		sketches = NULL;
+	}
+
+	// merge the sketches of the threads into those of thread 0 and write the quantiles and histogram of each order
+	void WriteSketches()
+	{
+		for (uint32 t = 1; t < args.numThreads; t++)
+			for (uint32 i = 0; i < MAX_ORDER * 2; i++)
+				sketches[i].Merge(sketches[t * MAX_ORDER * 2 + i]);
+
+		char *fn = new char[strlen(args.output) + 20];
+		NULL_CHECK(fn);
+		sprintf(fn, "%s.sketch.csv", args.output);
+		FILE *summary = fopen(fn, "w");
+		sprintf(fn, "%s.histogram.csv", args.output);
+		FILE *histogram = fopen(fn, "w");
+		NULL_CHECK(summary);
+		NULL_CHECK(histogram);
+		fprintf(summary, "ORDER,MEASURE,COUNT,MIN");
+		for (uint32 k = 0; k < SKETCH_QUANTILES; k++)
+			fprintf(summary, ",%s", sketchColumn[k]);
+		fprintf(summary, ",MAX\n");
+		fprintf(histogram, "ORDER,MEASURE,LOW,HIGH,COUNT,ABOVE\n");
+
+		for (uint32 o = 0; o < MAX_ORDER; o++)
+		{
+			for (uint32 m = OUT_PURITY; m <= OUT_IG; m++)
+			{
+				Sketch &sketch = sketches[o * 2 + m];
+				if (!sketch.count)
+					continue;
+				sketch.WriteSummary(summary, o, outName[m]);
+				sketch.WriteHistogram(histogram, o, outName[m]);
+			}
+		}
+		if (fclose(summary) || fclose(histogram))
+			ERROR("Cannot write sketch files");
+		printf("\nValue distributions written to %s.sketch.csv and %s.histogram.csv\n", args.output, args.output);
+		delete[] fn;
+	}
+
+	void OpenFiles(uint32 order)
+	{
+		writer = new OutputWriter();
+		NULL_CHECK(writer);
+		writer->Open(args, order, names, aliases, dataset->numVariable, stream);
+		writers[order] = writer;
+	}
+
+	// remove the thread files of every order (used when the run is cancelled)
+	void RemoveFiles()
+	{
+		char* fn = new char[strlen(args.output) + 20];
+		NULL_CHECK(fn);
+		for (uint32 order = 0; order < MAX_ORDER; order++)
+		{
+			for (uint32 t = 0; t < args.numThreads; t++)
+			{
+				if (args.printP[order])
+				{
+					sprintf(fn, "%s.Purity.%u.%u.%s", args.output, order, t, args.gz ? "csv.gz" : "csv");
+					remove(fn);
+				}
+				if (args.printIG[order])
+				{
+					sprintf(fn, "%s.IG.%u.%u.%s", args.output, order, t, args.gz ? "csv.gz" : "csv");
+					remove(fn);
+				}
+				for (uint32 m = OUT_METRIC; m < NUM_OUT; m++)
+				{
+					if (!args.Prints(m, order))
+						continue;
+					sprintf(fn, "%s.%s.%u.%u.%s", args.output, outName[m], order, t, args.gz ? "csv.gz" : "csv");
+					remove(fn);
+				}
+				if (args.sort)
+				{
+					for (uint32 m = 0; m < NUM_OUT; m++)
+					{
+						sprintf(fn, "%s.%s.%u.%u.run", args.output, outName[m], order, t);
+						remove(fn);
+					}
+				}
+			}
+		}
+		delete[]fn;
+	}
+
+	void CloseFiles(uint32 order)
+	{
+		writer->Close();
+	}
+
+
+	EpiStat()
+	{
+		return;
+	}
+
+	~EpiStat()
+	{
+		
+	}
+	
+	EpiStat(EpiStat *ref)
+	{
+		memcpy(this, ref, sizeof(EpiStat));
+	}
+
+	void Init(Dataset *d, PurityTable *pt, Placement *pl, ARGS a, volatile bool *c, void *(*tf1) (void *), void *(*tf2) (void *), void *(*tf3) (void *), void *(*tf4) (void *), void *(*tff) (void *), void *(*tfs) (void *))
+	{
+		queue = NULL;
+		split = NULL;
+		splitOrder = 0;
+		splitFunction = tfs;
+		stream = NULL;
+		sketches = NULL;
+		stop = NULL;
+		deadline = 0;
+		memset(covered, 0, sizeof(covered));
+		memset(prune, 0, sizeof(prune));
+		earlyBlocks = 0;
+		fusedFunction = tff;
+		dataset = d;
+		purity = pt;
+		placement = pl;
+		results = NULL;
+		previous = NULL;
+		counts = NULL;
+		carriers = NULL;
+		bits = d->bitCase != NULL;
+		numOld = 0;
+		memset(firstNew, 0, sizeof(firstNew));
+		varMap = NULL;
+		names = d->nameVariable;
+		aliases = d->alias;
+		numTarget = 0;
+		nextVar = NULL;
+		endVar = NULL;
+		owner = NULL;
+		memset(writers, 0, sizeof(writers));
+		memset(metricTable, 0, sizeof(metricTable));
+		memset(metricResults, 0, sizeof(metricResults));
+		args = a;
+		cancel = c;
+		threadFunction[0] = tf1;
+		threadFunction[1] = tf2;
+		threadFunction[2] = tf3;
+		threadFunction[3] = tf4;
+	}
+
+	// pin the thread and select its genotype replica before the thread touches its own memory
+	void BindThread()
+	{
+		placement->Pin(threadIdx);
+		node = placement->nodeOfThread[threadIdx];
+		numCombination = 0;
+		numPruned = 0;
+		memset(numOrder, 0, sizeof(numOrder));
+		memset(prefixReady, 0, sizeof(prefixReady));
+		beginTime = WallClock();
+	}
+
+	// whether the threads stop at the next work unit: cancelled, or stopped with the results so far
+	bool Stopped()
+	{
+		if (*cancel)
+			return true;
+		if (!*stop && (stopSignal || (deadline && WallClock() >= deadline)))
+			*stop = true;
+		return *stop;
+	}
+
+	void AllocateThreadMemory()
+	{
+		for (uint32 i = 0; i < MAX_ORDER-1; i++)
+		{
+			epiCaseWord[i] = new word[dataset->numWordCase];
+			epiCtrlWord[i] = new word[dataset->numWordCtrl];
+
+			NULL_CHECK(epiCaseWord[i]);
+			NULL_CHECK(epiCtrlWord[i]);
+
+			epiCaseBit[i] = bits ? new word[(uint64)dataset->numBitCase << (i + 1)] : NULL;
+			epiCtrlBit[i] = bits ? new word[(uint64)dataset->numBitCtrl << (i + 1)] : NULL;
+			if (bits)
+			{
+				NULL_CHECK(epiCaseBit[i]);
+				NULL_CHECK(epiCtrlBit[i]);
+			}
+		}
+
+		contingencyCase = new sampleIdx[(uint32)pow(2, MAX_ORDER * 2)];
+		contingencyCtrl = new sampleIdx[(uint32)pow(2, MAX_ORDER * 2)];
+
+		NULL_CHECK(contingencyCase);
+		NULL_CHECK(contingencyCtrl);
+	}
+
+	void FreeThreadMemory()
+	{
+		for (uint32 i = 0; i < MAX_ORDER-1; i++)
+		{
+			delete[] epiCaseWord[i];
+			delete[] epiCtrlWord[i];
+			delete[] epiCaseBit[i];
+			delete[] epiCtrlBit[i];
+		}
+
+		delete[] contingencyCase;
+		delete[] contingencyCtrl;
+	}
+
+	// dataset variable at a position of the run
+	varIdx Var(varIdx idx)
+	{
+		return varMap ? varMap[idx] : idx;
+	}
+
+	// end of the first position of a combination of order OIDX + 1
+	varIdx FirstEnd(uint32 OIDX)
+	{
+		varIdx end = dataset->numVariable - OIDX;
+		return (numTarget && numTarget < end) ? numTarget : end;
+	}
+
+	// first position that can follow idx in a combination
+	varIdx Next(varIdx idx)
+	{
+		return nextVar ? nextVar[idx] : idx + 1;
+	}
+
+	// end of the positions of a combination starting at idx
+	varIdx End(varIdx idx)
+	{
+		return endVar ? endVar[idx] : dataset->numVariable;
+	}
+
+	// first position of the last SNP of a combination of order o after idx, a resumed run only has combinations with a new SNP
+	varIdx Last(uint32 o, varIdx idx)
+	{
+		varIdx next = Next(idx);
+		return next > firstNew[o] ? next : firstNew[o];
+	}
+
+	// thread that processes the combinations starting at idx
+	uint32 Owner(varIdx idx)
+	{
+		return owner ? owner[idx] : idx % args.numThreads;
+	}
+
+	// count the contingency tables of a combination of k SNPs outside the kernels
+	void Count(varIdx *idx, uint32 k)
+	{
+		CountRange(idx, k, 0, dataset->numWordCase, 0, dataset->numWordCtrl);
+	}
+
+	// count the case words [caseBegin, caseEnd) and control words [ctrlBegin, ctrlEnd) of a combination of k SNPs
+	void CountRange(varIdx *idx, uint32 k, uint32 caseBegin, uint32 caseEnd, uint32 ctrlBegin, uint32 ctrlEnd)
+	{
+		word *caseData[MAX_ORDER];
+		word *ctrlData[MAX_ORDER];
+		for (uint32 o = 0; o < k; o++)
+		{
+			caseData[o] = dataset->GetVarCase(Var(idx[o]), node);
+			ctrlData[o] = dataset->GetVarCtrl(Var(idx[o]), node);
+		}
+
+		ResetContigencyTable_4();
+		WordByte wb;
+		for (uint32 i = caseBegin; i < caseEnd; i++)
+		{
+			wb.w = caseData[0][i];
+			for (uint32 o = 1; o < k; o++)
+				wb.w |= caseData[o][i] << (2 * o);
+			for (uint32 b = 0; b < byte_in_word; b++)
+				contingencyCase[wb.b[b]]++;
+		}
+
+		for (uint32 i = ctrlBegin; i < ctrlEnd; i++)
+		{
+			wb.w = ctrlData[0][i];
+			for (uint32 o = 1; o < k; o++)
+				wb.w |= ctrlData[o][i] << (2 * o);
+			for (uint32 b = 0; b < byte_in_word; b++)
+				contingencyCtrl[wb.b[b]]++;
+		}
+	}
+
+	// purity of a lower order combination that a -targets run does not save (it does not start with a target)
+	double Purity(varIdx *idx, uint32 k)
+	{
+		Count(idx, k);
+		return Gini(k - 1);
+	}
+
+	double Gini(uint32 o)
+	{
+		if (o == 0)
+			return Gini_1();
+		if (o == 1)
+			return Gini_2();
+		if (o == 2)
+			return Gini_3();
+		return Gini_4();
+	}
+
+	// whether a table holds the combinations of order o + 1 that start at a position (a fused traversal saves them as it goes)
+	bool Ready(PurityTable *t, uint32 o, varIdx first)
+	{
+		if (o && first >= t->numRow)
+			return false;
+		if (!queue || t->complete[o])
+			return true;
+#ifdef _MSC_VER
+		return *(volatile bool *)&queue->done[first];
+#else
+		return __atomic_load_n(&queue->done[first], __ATOMIC_ACQUIRE);
+#endif
+	}
+
+	// largest value in a table of the sub-combinations of a combination of order o + 1,
+	// recounted with metric k (NUM_METRIC for the purity) when the table does not hold it yet
+	double SubsetMax(PurityTable *t, uint32 k, uint32 o, varIdx *idx)
+	{
+		double max = 0;
+		varIdx sub[MAX_ORDER];
+		for (uint32 drop = 0; drop <= o; drop++)
+		{
+			for (uint32 i = 0, j = 0; i <= o; i++)
+				if (i != drop)
+					sub[j++] = idx[i];
+
+			// only the sub-combination without the first SNP starts at another position
+			double v;
+			if (drop || Ready(t, o - 1, sub[0]))
+				v = t->Get(o - 1, sub);
+			else
+			{
+				Count(sub, o);
+				v = (k == NUM_METRIC) ? Gini(o - 1) : Metric(k, o - 1);
+			}
+			max = (drop == 0 || v > max) ? v : max;
+		}
+		return max;
+	}
+
+	// another metric (METRIC_XXX) of the contingency tables of a combination of order o + 1
+	double Metric(uint32 k, uint32 o)
+	{
+		const uint32 entry[MAX_ORDER] = { 3, 9, 27, 81 };
+		double n = dataset->numSample;
+		double nCase = dataset->numCase;
+		double nCtrl = dataset->numCtrl;
+		double value = 0;
+
+		for (uint32 i = 0; i < entry[o]; i++)
+		{
+			uint32 index = cti[i];
+			double a = (double)contingencyCase[index];
+			double b = (double)contingencyCtrl[index];
+
+			// the padding samples of the last word are counted as genotype 0 of every SNP
+			if (!index)
+			{
+				a -= dataset->numByteCase - dataset->numCase;
+				b -= dataset->numByteCtrl - dataset->numCtrl;
+			}
+			double sum = a + b;
+			if (!sum)
+				continue;
+
+			if (k == METRIC_MI)
+			{
+				if (a)
+					value += a / n * log2(a * n / (sum * nCase));
+				if (b)
+					value += b / n * log2(b * n / (sum * nCtrl));
+			}
+			else if (k == METRIC_CHI2)
+			{
+				double eCase = sum * nCase / n;
+				double eCtrl = sum * nCtrl / n;
+				value += (a - eCase) * (a - eCase) / eCase + (b - eCtrl) * (b - eCtrl) / eCtrl;
+			}
+			else
+			{
+				double logOR = fabs(log((a + 0.5) * (nCtrl - b + 0.5) / ((b + 0.5) * (nCase - a + 0.5))));
+				value = (logOR > value) ? logOR : value;
+			}
+		}
+		return value;
+	}
+
+	// report, save and rank the other metrics of a combination of order o + 1, from the contingency tables of its purity
+	void Metrics(uint32 o, varIdx *idx)
+	{
+		double value[NUM_METRIC];
+		for (uint32 k = 0; k < NUM_METRIC; k++)
+			if (args.computeM[k][o])
+				value[k] = Metric(k, o);
+
+		// a -targets run only reports the SNPs that are targets
+		bool target = o || !numTarget || idx[0] < numTarget;
+		for (uint32 k = 0; k < NUM_METRIC; k++)
+		{
+			if (!args.computeM[k][o])
+				continue;
+			double v = value[k];
+
+			if (args.printM[k][o] && target)
+				if (v >= args.m[k][o])
+					writers[o]->Push(threadIdx, OUT_METRIC + 2 * k, v, idx);
+
+			if (args.saveM[k][o] && o < MAX_ORDER - 1)
+				metricTable[k]->Set(o, idx, v);
+
+			if (!args.computeMG[k][o] || !target)
+				continue;
+			double gain = v - (o ? SubsetMax(metricTable[k], k, o, idx) : 0);
+
+			if (args.printMG[k][o])
+				if (gain >= args.mg[k][o])
+					writers[o]->Push(threadIdx, OUT_METRIC + 2 * k + 1, gain, idx);
+
+			if (args.bestM[k])
+				metricResults[k]->Best(o, gain, v, idx);
+		}
+	}
+
+	void OR_1(varIdx idx)
+	{
+		const uint32 OIDX = 0; // SNP
+		prefixReady[OIDX + 1] = false;
+		if (bits)
+		{
+			OR_Bits(OIDX, idx);
+			return;
+		}
+		word *caseData = dataset->GetVarCase(Var(idx), node);
+		word *ctrlData = dataset->GetVarCtrl(Var(idx), node);
+
+		for (uint32 i = 0; i < dataset->numWordCase; i++)
+		{
+			epiCaseWord[OIDX][i] = caseData[i];
+		}
+
+		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
+		{
+			epiCtrlWord[OIDX][i] = ctrlData[i];
+		}
+	}
+
+	void OR_2(varIdx idx)
+	{
+		const uint32 OIDX = 1; // Pair
+		prefixReady[OIDX + 1] = false;
+		const uint32 SHIFT = 2 * OIDX; // genotype bits of this SNP in the contingency table index
+		if (bits)
+		{
+			OR_Bits(OIDX, idx);
+			return;
+		}
+		word *caseData = dataset->GetVarCase(Var(idx), node);
+		word *ctrlData = dataset->GetVarCtrl(Var(idx), node);
+
+		for (uint32 i = 0; i < dataset->numWordCase; i++)
+		{
+			epiCaseWord[OIDX][i] = epiCaseWord[OIDX - 1][i] | (caseData[i] << SHIFT);
+		}
+
+		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
+		{
+			epiCtrlWord[OIDX][i] = epiCtrlWord[OIDX - 1][i] | (ctrlData[i] << SHIFT);
+		}
+	}
+
+	void OR_3(varIdx idx)
+	{
+		const uint32 OIDX = 2; // Triplet
+		prefixReady[OIDX + 1] = false;
+		const uint32 SHIFT = 2 * OIDX; // genotype bits of this SNP in the contingency table index
+		if (bits)
+		{
+			OR_Bits(OIDX, idx);
+			return;
+		}
+		word *caseData = dataset->GetVarCase(Var(idx), node);
+		word *ctrlData = dataset->GetVarCtrl(Var(idx), node);
+
+		for (uint32 i = 0; i < dataset->numWordCase; i++)
+		{
+			epiCaseWord[OIDX][i] = epiCaseWord[OIDX - 1][i] | (caseData[i] << SHIFT);
+		}
+
+		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
+		{
+			epiCtrlWord[OIDX][i] = epiCtrlWord[OIDX - 1][i] | (ctrlData[i] << SHIFT);
+		}
+	}
+
+	// count the tables of a combination of order o + 1 after OR_1 to OR_3 of its first o SNPs, with the bit kernel for
+	// binary genotypes (-model dominant or recessive), or from the carriers of its last SNP if it is rare (-sparse)
+	void CountLast(uint32 o, varIdx *idx)
+	{
+		if (bits)
+			CountBits(o, idx);
+		else if (carriers && carriers->rare[Var(idx[o])])
+			CountCarriers(o, idx);
+		else if (o == 0)
+			OR_1x(idx[0]);
+		else if (o == 1)
+			OR_2x(idx[1]);
+		else if (o == 2)
+			OR_3x(idx[2]);
+		else
+			OR_4x(idx[3]);
+	}
+
+	// start from the table of the first o SNPs, every sample with genotype 0 for the last one, and move each of its
+	// carriers to its own genotype; the cells must be zero, as ResetContigencyTable_N leaves them
+	void CountCarriers(uint32 o, varIdx *idx)
+	{
+		if (o == 0)
+		{
+			contingencyCase[0] = dataset->numByteCase;
+			contingencyCtrl[0] = dataset->numByteCtrl;
+		}
+		else if (prefixReady[o])
+		{
+			memcpy(contingencyCase, prefixCase[o], (1 << (2 * o)) * sizeof(sampleIdx));
+			memcpy(contingencyCtrl, prefixCtrl[o], (1 << (2 * o)) * sizeof(sampleIdx));
+		}
+		else
+		{
+			CountWords(o - 1);
+			memcpy(prefixCase[o], contingencyCase, (1 << (2 * o)) * sizeof(sampleIdx));
+			memcpy(prefixCtrl[o], contingencyCtrl, (1 << (2 * o)) * sizeof(sampleIdx));
+			prefixReady[o] = true;
+		}
+
+		const uint32 SHIFT = 2 * o;
+		uint64 v = 2 * (uint64)Var(idx[o]);
+		const uint8 *caseByte = o ? (const uint8 *)epiCaseWord[o - 1] : NULL;
+		const uint8 *ctrlByte = o ? (const uint8 *)epiCtrlWord[o - 1] : NULL;
+		for (uint64 c = carriers->begin[v]; c < carriers->begin[v + 1]; c++)
+		{
+			uint32 x = carriers->carrier[c];
+			uint8 cell = o ? caseByte[x >> 2] : 0;
+			contingencyCase[cell]--;
+			contingencyCase[cell | ((x & 3) << SHIFT)]++;
+		}
+		for (uint64 c = carriers->begin[v + 1]; c < carriers->begin[v + 2]; c++)
+		{
+			uint32 x = carriers->carrier[c];
+			uint8 cell = o ? ctrlByte[x >> 2] : 0;
+			contingencyCtrl[cell]--;
+			contingencyCtrl[cell | ((x & 3) << SHIFT)]++;
+		}
+	}
+
+	// split the cells of the first o SNPs by the bit of SNP idx into the masks of level o, and count them
+	void OR_Bits(uint32 o, varIdx idx)
+	{
+		SplitBits(o, dataset->GetVarBitCase(Var(idx)), dataset->numBitCase, epiCaseBit, bitCountCase);
+		SplitBits(o, dataset->GetVarBitCtrl(Var(idx)), dataset->numBitCtrl, epiCtrlBit, bitCountCtrl);
+	}
+
+	POPCOUNT_CLONES
+	void SplitBits(uint32 o, const word *data, uint32 numWord, word **mask, uint32 (*count)[8])
+	{
+		const uint32 cells = 1 << o; // cells of the first o SNPs
+		word *out = mask[o];
+		uint32 n[8] = {0};           // samples of each of them with the bit of this SNP set
+
+		if (o == 0)
+		{
+			for (uint32 i = 0; i < numWord; i++)
+			{
+				out[2 * i] = ~data[i];
+				out[2 * i + 1] = data[i];
+				n[0] += (uint32)POPCOUNT(data[i]);
+			}
+		}
+		else
+		{
+			const word *in = mask[o - 1];
+			for (uint32 i = 0; i < numWord; i++)
+			{
+				word x = data[i];
+				for (uint32 c = 0; c < cells; c++)
+				{
+					word m = in[i * cells + c];
+					out[2 * i * cells + c] = m & ~x;
+					out[2 * i * cells + cells + c] = m & x;
+					n[c] += (uint32)POPCOUNT(m & x);
+				}
+			}
+		}
+
+		for (uint32 c = 0; c < cells; c++)
+		{
+			count[o][cells + c] = n[c];
+			count[o][c] = (o ? count[o - 1][c] : numWord * bit_in_word) - n[c];
+		}
+	}
+
+	// the tables of a combination of order o + 1 from the masks of its first o SNPs and the bits of its last one
+	void CountBits(uint32 o, varIdx *idx)
+	{
+		CountBitClass(o, dataset->GetVarBitCase(Var(idx[o])), dataset->numBitCase, dataset->numByteCase, epiCaseBit, bitCountCase, contingencyCase);
+		CountBitClass(o, dataset->GetVarBitCtrl(Var(idx[o])), dataset->numBitCtrl, dataset->numByteCtrl, epiCtrlBit, bitCountCtrl, contingencyCtrl);
+	}
+
+	// each cell of the first o SNPs splits into the samples with the last bit set, counted with one AND and one popcount
+	// per word and cell, and the others; cell 0 keeps the padding of the byte kernels, numByte - numSample samples
+	POPCOUNT_CLONES
+	void CountBitClass(uint32 o, const word *data, uint32 numWord, uint32 numByte, word **mask, uint32 (*count)[8], sampleIdx *table)
+	{
+		const uint32 cells = 1 << o;
+		uint32 n[8] = {0};
+
+		if (o == 0)
+		{
+			for (uint32 i = 0; i < numWord; i++)
+				n[0] += (uint32)POPCOUNT(data[i]);
+		}
+		else
+		{
+			const word *in = mask[o - 1];
+			for (uint32 i = 0; i < numWord; i++)
+			{
+				word x = data[i];
+				for (uint32 c = 0; c < cells; c++)
+					n[c] += (uint32)POPCOUNT(in[i * cells + c] & x);
+			}
+		}
+
+		for (uint32 c = 0; c < cells; c++)
+		{
+			uint32 rest = (o ? count[o - 1][c] : numWord * bit_in_word) - n[c];
+			table[bti[c]] = (sampleIdx)(c ? rest : rest - (numWord * bit_in_word - numByte));
+			table[bti[cells + c]] = (sampleIdx)n[c];
+		}
+	}
+
+	void OR_1x(varIdx idx)
+	{
+		word *caseData = dataset->GetVarCase(Var(idx), node);
+		word *ctrlData = dataset->GetVarCtrl(Var(idx), node);
+
+		WordByte wb;
+		for (uint32 i = 0; i < dataset->numWordCase; i++)
+		{
+			wb.w = caseData[i];
+			contingencyCase[wb.b[0]]++;
+			contingencyCase[wb.b[1]]++;
+			contingencyCase[wb.b[2]]++;
+			contingencyCase[wb.b[3]]++;
+			contingencyCase[wb.b[4]]++;
+			contingencyCase[wb.b[5]]++;
+			contingencyCase[wb.b[6]]++;
+			contingencyCase[wb.b[7]]++;
+		}
+
+		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
+		{
+			wb.w = ctrlData[i];
+			contingencyCtrl[wb.b[0]]++;
+			contingencyCtrl[wb.b[1]]++;
+			contingencyCtrl[wb.b[2]]++;
+			contingencyCtrl[wb.b[3]]++;
+			contingencyCtrl[wb.b[4]]++;
+			contingencyCtrl[wb.b[5]]++;
+			contingencyCtrl[wb.b[6]]++;
+			contingencyCtrl[wb.b[7]]++;
+		}
+	}
+
+	void OR_2x(varIdx idx)
+	{
+		const uint32 OIDX = 1; // Pair
+		const uint32 SHIFT = 2 * OIDX; // genotype bits of this SNP in the contingency table index
+		word *caseData = dataset->GetVarCase(Var(idx), node);
+		word *ctrlData = dataset->GetVarCtrl(Var(idx), node);
+
+		WordByte wb;
+		for (uint32 i = 0; i < dataset->numWordCase; i++)
+		{
+			wb.w = epiCaseWord[OIDX - 1][i] | (caseData[i] << SHIFT);
+			contingencyCase[wb.b[0]]++;
+			contingencyCase[wb.b[1]]++;
+			contingencyCase[wb.b[2]]++;
+			contingencyCase[wb.b[3]]++;
+			contingencyCase[wb.b[4]]++;
+			contingencyCase[wb.b[5]]++;
+			contingencyCase[wb.b[6]]++;
+			contingencyCase[wb.b[7]]++;
+		}
+
+		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
+		{
+			wb.w = epiCtrlWord[OIDX - 1][i] | (ctrlData[i] << SHIFT);
+			contingencyCtrl[wb.b[0]]++;
+			contingencyCtrl[wb.b[1]]++;
+			contingencyCtrl[wb.b[2]]++;
+			contingencyCtrl[wb.b[3]]++;
+			contingencyCtrl[wb.b[4]]++;
+			contingencyCtrl[wb.b[5]]++;
+			contingencyCtrl[wb.b[6]]++;
+			contingencyCtrl[wb.b[7]]++;
+		}
+	}
+
+	void OR_3x(varIdx idx)
+	{
+		const uint32 OIDX = 2; // Triplet
+		const uint32 SHIFT = 2 * OIDX; // genotype bits of this SNP in the contingency table index
+		word *caseData = dataset->GetVarCase(Var(idx), node);
+		word *ctrlData = dataset->GetVarCtrl(Var(idx), node);
+
+		WordByte wb;
+		for (uint32 i = 0; i < dataset->numWordCase; i++)
+		{
+			wb.w = epiCaseWord[OIDX - 1][i] | (caseData[i] << SHIFT);
+			contingencyCase[wb.b[0]]++;
+			contingencyCase[wb.b[1]]++;
+			contingencyCase[wb.b[2]]++;
+			contingencyCase[wb.b[3]]++;
+			contingencyCase[wb.b[4]]++;
+			contingencyCase[wb.b[5]]++;
+			contingencyCase[wb.b[6]]++;
+			contingencyCase[wb.b[7]]++;
+		}
+
+		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
+		{
+			wb.w = epiCtrlWord[OIDX - 1][i] | (ctrlData[i] << SHIFT);
+			contingencyCtrl[wb.b[0]]++;
+			contingencyCtrl[wb.b[1]]++;
+			contingencyCtrl[wb.b[2]]++;
+			contingencyCtrl[wb.b[3]]++;
+			contingencyCtrl[wb.b[4]]++;
+			contingencyCtrl[wb.b[5]]++;
+			contingencyCtrl[wb.b[6]]++;
+			contingencyCtrl[wb.b[7]]++;
+		}
+	}
+
+	void OR_4x(varIdx idx)
+	{
+		const uint32 OIDX = 3; // Quadlet
+		const uint32 SHIFT = 2 * OIDX; // genotype bits of this SNP in the contingency table index
+		word *caseData = dataset->GetVarCase(Var(idx), node);
+		word *ctrlData = dataset->GetVarCtrl(Var(idx), node);
+
+		WordByte wb;
+		for (uint32 i = 0; i < dataset->numWordCase; i++)
+		{
+			wb.w = epiCaseWord[OIDX - 1][i] | (caseData[i] << SHIFT);
+			contingencyCase[wb.b[0]]++;
+			contingencyCase[wb.b[1]]++;
+			contingencyCase[wb.b[2]]++;
+			contingencyCase[wb.b[3]]++;
+			contingencyCase[wb.b[4]]++;
+			contingencyCase[wb.b[5]]++;
+			contingencyCase[wb.b[6]]++;
+			contingencyCase[wb.b[7]]++;
+		}
+
+		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
+		{
+			wb.w = epiCtrlWord[OIDX - 1][i] | (ctrlData[i] << SHIFT);
+			contingencyCtrl[wb.b[0]]++;
+			contingencyCtrl[wb.b[1]]++;
+			contingencyCtrl[wb.b[2]]++;
+			contingencyCtrl[wb.b[3]]++;
+			contingencyCtrl[wb.b[4]]++;
+			contingencyCtrl[wb.b[5]]++;
+			contingencyCtrl[wb.b[6]]++;
+			contingencyCtrl[wb.b[7]]++;
+		}
+	}
+	
+	void ResetContigencyTable_1()
+	{
+		memset(contingencyCtrl, 0, 4 * sizeof(sampleIdx));
+		memset(contingencyCase, 0, 4 * sizeof(sampleIdx));
+	}
+
+	void ResetContigencyTable_2()
+	{
+		memset(contingencyCtrl, 0, 16 * sizeof(sampleIdx));
+		memset(contingencyCase, 0, 16 * sizeof(sampleIdx));
+	}
+
+	void ResetContigencyTable_3()
+	{
+		memset(contingencyCtrl, 0, 64 * sizeof(sampleIdx));
+		memset(contingencyCase, 0, 64 * sizeof(sampleIdx));
+	}
+
+	void ResetContigencyTable_4()
+	{
+		memset(contingencyCtrl, 0, 256 * sizeof(sampleIdx));
+		memset(contingencyCase, 0, 256 * sizeof(sampleIdx));
+	}
+
+	// the smallest purity a combination of order o + 1 must reach to be reported (-early)
+	double Need(uint32 o, varIdx *idx)
+	{
+		double need = args.printP[o] ? args.p[o] : 2;
+		if (args.printIG[o])
+		{
+			double ig = args.ig[o] + SubsetMax(purity, NUM_METRIC, o, idx);
+			need = ig < need ? ig : need;
+		}
+		return need;
+	}
+
+	// add the samples of words [from, to) of a combination to a contingency table, as OR_Nx does
+	void OR_Words(sampleIdx *table, word *prefix, word *data, uint32 shift, uint32 from, uint32 to)
+	{
+		WordByte wb;
+		for (uint32 i = from; i < to; i++)
+		{
+			wb.w = prefix[i] | (data[i] << shift);
+			table[wb.b[0]]++;
+			table[wb.b[1]]++;
+			table[wb.b[2]]++;
+			table[wb.b[3]]++;
+			table[wb.b[4]]++;
+			table[wb.b[5]]++;
+			table[wb.b[6]]++;
+			table[wb.b[7]]++;
+		}
+	}
+
+	// count the contingency tables of a combination of order o + 1 in blocks of samples, false once even the
+	// samples not counted yet cannot bring it to its threshold: a sample adds at most 1 to the sum of the
+	// purity terms (a² + b²) / (a + b), and a term is at least half of its samples. The blocks counted before
+	// that bound can fall short of the threshold are counted in one pass, so that a low threshold costs no
+	// more than OR_Nx.
+	bool CountEarly(uint32 o, varIdx *idx)
+	{
+		const uint32 entry[MAX_ORDER] = { 3, 9, 27, 81 };
+		const uint32 SHIFT = 2 * o;
+		double need = (Need(o, idx) - EARLY_MARGIN) * dataset->numSample;
+
+		// the IG of the targets recounts a sub-combination in the tables
+		memset(contingencyCtrl, 0, (4 << (2 * o)) * sizeof(sampleIdx));
+		memset(contingencyCase, 0, (4 << (2 * o)) * sizeof(sampleIdx));
+
+		word *caseData = dataset->GetVarCase(Var(idx[o]), node);
+		word *ctrlData = dataset->GetVarCtrl(Var(idx[o]), node);
+		word *casePrefix = epiCaseWord[o - 1];
+		word *ctrlPrefix = epiCtrlWord[o - 1];
+		uint32 numWordCase = dataset->numWordCase;
+		uint32 numWordCtrl = dataset->numWordCtrl;
+		double total = (double)(dataset->numByteCase + dataset->numByteCtrl);
+
+		uint32 caseBegin = 0;
+		uint32 ctrlBegin = 0;
+		for (uint32 b = 0; b < earlyBlocks; b++)
+		{
+			uint32 caseEnd = (uint32)((uint64)numWordCase * (b + 1) / earlyBlocks);
+			uint32 ctrlEnd = (uint32)((uint64)numWordCtrl * (b + 1) / earlyBlocks);
+			double counted = (double)(caseEnd + ctrlEnd) * byte_in_word;
+			bool last = b + 1 == earlyBlocks;
+			if (!last && total - counted / 2 >= need)
+				continue; // the bound cannot fall short yet, count this block with the next ones
+
+			OR_Words(contingencyCase, casePrefix, caseData, SHIFT, caseBegin, caseEnd);
+			OR_Words(contingencyCtrl, ctrlPrefix, ctrlData, SHIFT, ctrlBegin, ctrlEnd);
+			caseBegin = caseEnd;
+			ctrlBegin = ctrlEnd;
+			if (last)
+				break;
+
+			double bound = total - counted;
+			for (uint32 i = 0; i < entry[o]; i++)
+			{
+				uint32 index = cti[i];
+				double nCase = (double)contingencyCase[index];
+				double nCtrl = (double)contingencyCtrl[index];
+				double sum = nCase + nCtrl;
+				if (sum)
+					bound += (P2(nCase) + P2(nCtrl)) / sum;
+			}
+			if (bound < need)
+			{
+				numPruned++;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	double Gini_1()
+	{
+		// binary genotypes (-model dominant or recessive) only fill the 2^N cells of bti, in the order of cti
+		const uint32 entry = bits ? 2 : 3;
+		const uint8 *cell = bits ? bti : cti;
+		double purity = 0;
+
+		for (uint32 i = 0; i < entry; i++)
+		{
+			uint32 index = cell[i];
+			double nCase = (double)contingencyCase[index];
+			double nCtrl = (double)contingencyCtrl[index];
+			double sum = nCase + nCtrl;
+			if (sum)
+				purity += (P2(nCase) + P2(nCtrl)) / (sum * dataset->numSample);
+		}
+		return purity;
+	}
+
+	double Gini_2()
+	{
+		const uint32 entry = bits ? 4 : 9;
+		const uint8 *cell = bits ? bti : cti;
+		double purity = 0;
+
+		for (uint32 i = 0; i < entry; i++)
+		{
+			uint32 index = cell[i];
+			double nCase = (double)contingencyCase[index];
+			double nCtrl = (double)contingencyCtrl[index];
+			double sum = nCase + nCtrl;
+			if (sum)
+				purity += (P2(nCase) + P2(nCtrl)) / (sum * dataset->numSample);
+		}
+		return purity;
+	}
+	
+	double Gini_3()
+	{
+		const uint32 entry = bits ? 8 : 27;
+		const uint8 *cell = bits ? bti : cti;
+		double purity = 0;
+
+		for (uint32 i = 0; i < entry; i++)
+		{
+			uint32 index = cell[i];
+			double nCase = (double)contingencyCase[index];
+			double nCtrl = (double)contingencyCtrl[index];
+			double sum = nCase + nCtrl;
+			if (sum)
+				purity += (P2(nCase) + P2(nCtrl)) / (sum * dataset->numSample);
+		}
+		return purity;
+	}
+
+	double Gini_4()
+	{
+		const uint32 entry = bits ? 16 : 81;
+		const uint8 *cell = bits ? bti : cti;
+		double purity = 0;
+
+		for (uint32 i = 0; i < entry; i++)
+		{
+			uint32 index = cell[i];
+			double nCase = (double)contingencyCase[index];
+			double nCtrl = (double)contingencyCtrl[index];
+			double sum = nCase + nCtrl;
+			if (sum)
+				purity += (P2(nCase) + P2(nCtrl)) / (sum * dataset->numSample);
+		}
+		return purity;
+	}
+
+	void Epi_1(uint32 id)
+	{
+		const uint32 OIDX = 0; // SNP
+		threadIdx = id;
+
+		BindThread();
+		AllocateThreadMemory();
+
+		printf("Thread %4u starting ...\n", threadIdx);
+
+		varIdx idx[1];
+
+		for (idx[0] = 0; idx[0] < dataset->numVariable; idx[0]++)
+		{
+			if (Stopped())
+				break;
+			uint32 pt = Owner(idx[0]);
+			if (pt == threadIdx)
+			{
+#ifdef PTEST
+				clock_t xc1 = clock();
+#endif
+				ResetContigencyTable_1();
+				numCombination++;
+#ifdef PTEST
+				clock_t xc2 = clock();
+#endif
+				CountLast(OIDX, idx);
+#ifdef PTEST
+				clock_t xc3 = clock();
+#endif
+				// compute purity
+				double p = counts ? counts->Add(OIDX, idx, contingencyCase, contingencyCtrl) : Gini_1();
+#ifdef PTEST
+				clock_t xc4 = clock();
+#endif
+				// the other metrics, before an IG recount reuses the contingency tables
+				if (args.metrics)
+					Metrics(OIDX, idx);
+				// report SNP combination if purity meet threshold
+				bool target = !numTarget || idx[0] < numTarget;
+				if (sketches && target)
+					AddSketch(OIDX, OUT_PURITY, p);
+				if (args.printP[OIDX] && target)
+					if (p >= args.p[OIDX])
+						writer->Push(threadIdx, OUT_PURITY, p, idx);
+
+				// Save Purity to compute IG of next order
+				if (args.saveP[OIDX])
+					purity->SnpPurity[idx[0]] = p;
+
+				// compute Information Gained
+				if (args.computeIG[OIDX] && target)
+				{
+					double max_p = counts ? counts->setPurity : dataset->setPurity;
+
+					double ig = p - max_p;
+
+					if (sketches)
+						AddSketch(OIDX, OUT_IG, ig);
+
+					// report SNP combination if IG meet threshold
+					if (args.printIG[OIDX])
+						if (ig >= args.ig[OIDX])
+							writer->Push(threadIdx, OUT_IG, ig, idx);
+
+					// compute the best IG
+					if (args.bestIG)
+						results->Max_1(ig, p, idx);
+				}
+#ifdef PTEST
+				clock_t xc5 = clock();
+				elapse[1] += xc2 - xc1;
+				elapse[2] += xc3 - xc2;
+				elapse[3] += xc4 - xc3;
+				elapse[4] += xc5 - xc4;
+#endif
+			}
+		}
+
+		numOrder[OIDX] = numCombination;
+		endTime = WallClock();
+		printf("Thread %4u Finish\n", threadIdx);
+		FreeThreadMemory();
+	}
+	
+	void Epi_2(uint32 id)
+	{
+		const uint32 OIDX = 1; // Pair
+		threadIdx = id;
+
+		BindThread();
+		AllocateThreadMemory();
+
+		printf("Thread %4u starting ...\n", threadIdx);
+
+		varIdx idx[2];
+
+		for (idx[0] = 0; idx[0] < FirstEnd(OIDX); idx[0]++)
+		{
+			if (Stopped())
+				break;
+			uint32 pt = Owner(idx[0]);
+			if (pt == threadIdx || numTarget)
+			{
+				OR_1(idx[0]);
+				for (idx[1] = Last(OIDX, idx[0]); idx[1] < End(idx[0]); idx[1]++)
+				{
+					// a -targets run has few first positions, its threads split the second one
+					if (numTarget && (idx[1] % args.numThreads) != threadIdx)
+						continue;
+#ifdef PTEST
+					clock_t xc1 = clock();
+#endif
+					ResetContigencyTable_2();
+					numCombination++;
+#ifdef PTEST
+					clock_t xc2 = clock();
+#endif
+					if (!prune[OIDX])
+						CountLast(OIDX, idx);
+					else if (!CountEarly(OIDX, idx))
+						continue; // -early: the pair cannot reach its threshold
+#ifdef PTEST
+					clock_t xc3 = clock();
+#endif
+					// compute purity
+					double p = counts ? counts->Add(OIDX, idx, contingencyCase, contingencyCtrl) : Gini_2();
+#ifdef PTEST
+					clock_t xc4 = clock();
+#endif
+					// the other metrics, before an IG recount reuses the contingency tables
+					if (args.metrics)
+						Metrics(OIDX, idx);
+					// the distributions of -sketch
+					if (sketches)
+						AddSketch(OIDX, OUT_PURITY, p);
+					// report SNP combination if purity meet threshold
+					if (args.printP[OIDX])
+						if (p >= args.p[OIDX])
+							writer->Push(threadIdx, OUT_PURITY, p, idx);
 
-					// report SNP combination if IG meet threshold
-					if (args.printIG[OIDX])
-						if (ig >= args.ig[OIDX])
-							fprintf(topIGfile[threadIdx], "%f,%s\n", ig, dataset->nameVariable[idx[0]]);
+					// Save Purity to compute IG of next order
+					if (args.saveP[OIDX])
+						purity->PairPurity[idx[0]][idx[1]] = p;
 
-					// compute the best IG
-					if (args.bestIG)
-						dataset->results[threadIdx].Max_1(ig, p, idx);
+					// compute Information Gained
+					if (args.computeIG[OIDX])
+					{
+						double max_p = (purity->SnpPurity[idx[1]] > purity->SnpPurity[idx[0]]) ? purity->SnpPurity[idx[1]] : purity->SnpPurity[idx[0]];
+		
+						double ig = p - max_p;
+
+						if (sketches)
+							AddSketch(OIDX, OUT_IG, ig);
+
+						// report SNP combination if IG meet threshold
+						if (args.printIG[OIDX])
+							if (ig >= args.ig[OIDX])
+								writer->Push(threadIdx, OUT_IG, ig, idx);
+
+						// compute the best IG, the state of a resumed run has the combinations of its SNPs
+						if (args.bestIG && idx[OIDX] >= numOld)
+							results->Max_2(ig, p, idx);
+					}
+#ifdef PTEST
+					clock_t xc5 = clock();
+					elapse[1] += xc2 - xc1;
+					elapse[2] += xc3 - xc2;
+					elapse[3] += xc4 - xc3;
+					elapse[4] += xc5 - xc4;
+#endif
 				}
+			}
+		}
+		numOrder[OIDX] = numCombination;
+		endTime = WallClock();
+		printf("Thread %4u Finish\n", threadIdx);
+		FreeThreadMemory();
+	}
+
+	void Epi_3(uint32 id)
+	{
+		const uint32 OIDX = 2; // Triplet
+		threadIdx = id;
+
+		BindThread();
+		AllocateThreadMemory();
+
+		printf("Thread %4u starting ...\n", threadIdx);
+
+		varIdx idx[3];
+
+		for (idx[0] = 0; idx[0] < FirstEnd(OIDX); idx[0]++)
+		{
+			if (Stopped())
+				break;
+			uint32 pt = Owner(idx[0]);
+			if (pt == threadIdx || numTarget)
+			{
+				OR_1(idx[0]);
+				for (idx[1] = Next(idx[0]); idx[1] + (OIDX - 1) < End(idx[0]); idx[1]++)
+				{
+					// a -targets run has few first positions, its threads split the second one
+					if (numTarget && (idx[1] % args.numThreads) != threadIdx)
+						continue;
+					if (Stopped())
+						break;
+					OR_2(idx[1]);
+					for (idx[2] = Last(OIDX, idx[1]); idx[2] < End(idx[0]); idx[2]++)
+					{
 #ifdef PTEST
-				clock_t xc5 = clock();
-				elapse[1] += xc2 - xc1;
-				elapse[2] += xc3 - xc2;
-				elapse[3] += xc4 - xc3;
-				elapse[4] += xc5 - xc4;
+						clock_t xc1 = clock();
+#endif
+						ResetContigencyTable_3();
+						numCombination++;
+#ifdef PTEST
+						clock_t xc2 = clock();
+#endif
+						if (!prune[OIDX])
+							CountLast(OIDX, idx);
+						else if (!CountEarly(OIDX, idx))
+							continue; // -early: the triplet cannot reach its threshold
+#ifdef PTEST
+						clock_t xc3 = clock();
+#endif
+						// compute purity
+						double p = Gini_3();
+#ifdef PTEST
+						clock_t xc4 = clock();
+#endif
+						// the other metrics, before an IG recount reuses the contingency tables
+						if (args.metrics)
+							Metrics(OIDX, idx);
+						// the distributions of -sketch
+						if (sketches)
+							AddSketch(OIDX, OUT_PURITY, p);
+						// report SNP combination if purity meet threshold
+						if (args.printP[OIDX])
+							if (p >= args.p[OIDX])
+								writer->Push(threadIdx, OUT_PURITY, p, idx);
+
+						// Save Purity to compute IG of next order
+						if (args.saveP[OIDX])
+							purity->tripletPurity[idx[0]][idx[1]][idx[2]] = p;
+
+						// compute Information Gained
+						if (args.computeIG[OIDX])
+						{
+							double max_p = (purity->PairPurity[idx[0]][idx[1]] > purity->PairPurity[idx[0]][idx[2]]) ? purity->PairPurity[idx[0]][idx[1]] : purity->PairPurity[idx[0]][idx[2]];
+							double sub_p = (idx[1] < purity->numRow) ? purity->PairPurity[idx[1]][idx[2]] : Purity(idx + 1, 2);
+							max_p = (sub_p > max_p) ? sub_p : max_p;
+
+							double ig = p - max_p;
+
+							if (sketches)
+								AddSketch(OIDX, OUT_IG, ig);
+
+							// report SNP combination if IG meet threshold
+							if (args.printIG[OIDX])
+								if (ig >= args.ig[OIDX])
+									writer->Push(threadIdx, OUT_IG, ig, idx);
+
+							// compute the best IG, the state of a resumed run has the combinations of its SNPs
+							if (args.bestIG && idx[OIDX] >= numOld)
+								results->Max_3(ig, p, idx);
+						}
+#ifdef PTEST
+						clock_t xc5 = clock();
+						elapse[1] += xc2 - xc1;
+						elapse[2] += xc3 - xc2;
+						elapse[3] += xc4 - xc3;
+						elapse[4] += xc5 - xc4;
+#endif
+					}
+				}
+			}
+		}
+		numOrder[OIDX] = numCombination;
+		endTime = WallClock();
+		printf("Thread %4u Finish\n", threadIdx);
+		FreeThreadMemory();
+	}
+
+	void Epi_4(uint32 id)
+	{
+		const uint32 OIDX = 3; // Quadlet
+		threadIdx = id;
+
+		BindThread();
+		AllocateThreadMemory();
+
+		printf("Thread %4u starting ...\n", threadIdx);
+
+		varIdx idx[4];
+
+		for (idx[0] = 0; idx[0] < FirstEnd(OIDX); idx[0]++)
+		{
+			if (Stopped())
+				break;
+			uint32 pt = Owner(idx[0]);
+			if (pt == threadIdx || numTarget)
+			{
+				OR_1(idx[0]);
+				for (idx[1] = Next(idx[0]); idx[1] + (OIDX - 1) < End(idx[0]); idx[1]++)
+				{
+					// a -targets run has few first positions, its threads split the second one
+					if (numTarget && (idx[1] % args.numThreads) != threadIdx)
+						continue;
+					if (Stopped())
+						break;
+					OR_2(idx[1]);
+					for (idx[2] = Next(idx[1]); idx[2] + (OIDX - 2) < End(idx[0]); idx[2]++)
+					{
+						OR_3(idx[2]);
+						for (idx[3] = Last(OIDX, idx[2]); idx[3] < End(idx[0]); idx[3]++)
+						{
+#ifdef PTEST
+							clock_t xc1 = clock();
+#endif
+							ResetContigencyTable_4();
+							numCombination++;
+#ifdef PTEST
+							clock_t xc2 = clock();
+#endif
+							if (!prune[OIDX])
+								CountLast(OIDX, idx);
+							else if (!CountEarly(OIDX, idx))
+								continue; // -early: the quadlet cannot reach its threshold
+#ifdef PTEST
+							clock_t xc3 = clock();
+#endif
+							// compute purity
+							double p = Gini_4();
+#ifdef PTEST
+							clock_t xc4 = clock();
+#endif
+							// the other metrics, before an IG recount reuses the contingency tables
+							if (args.metrics)
+								Metrics(OIDX, idx);
+
+							// the distributions of -sketch
+							if (sketches)
+								AddSketch(OIDX, OUT_PURITY, p);
+							// report SNP combination if purity meet threshold
+							if (args.printP[OIDX])
+								if (p >= args.p[OIDX])
+									writer->Push(threadIdx, OUT_PURITY, p, idx);
+
+							// compute Information Gained
+							if (args.computeIG[OIDX])
+							{
+								double max_p = (purity->tripletPurity[idx[0]][idx[1]][idx[2]] > purity->tripletPurity[idx[0]][idx[1]][idx[3]]) ? purity->tripletPurity[idx[0]][idx[1]][idx[2]] : purity->tripletPurity[idx[0]][idx[1]][idx[3]];
+								max_p = (purity->tripletPurity[idx[0]][idx[2]][idx[3]] > max_p) ? purity->tripletPurity[idx[0]][idx[2]][idx[3]] : max_p;
+								double sub_p = (idx[1] < purity->numRow) ? purity->tripletPurity[idx[1]][idx[2]][idx[3]] : Purity(idx + 1, 3);
+								max_p = (sub_p > max_p) ? sub_p : max_p;
+
+								double ig = p - max_p;
+
+								if (sketches)
+									AddSketch(OIDX, OUT_IG, ig);
+
+								// report SNP combination if IG meet threshold
+								if (args.printIG[OIDX])
+									if (ig >= args.ig[OIDX])
+										writer->Push(threadIdx, OUT_IG, ig, idx);
+
+								// compute the best IG, the state of a resumed run has the combinations of its SNPs
+								if (args.bestIG && idx[OIDX] >= numOld)
+									results->Max_4(ig, p, idx);
+							}
+#ifdef PTEST
+							clock_t xc5 = clock();
+							elapse[1] += xc2 - xc1;
+							elapse[2] += xc3 - xc2;
+							elapse[3] += xc4 - xc3;
+							elapse[4] += xc5 - xc4;
+#endif
+						}
+					}
+				}
+			}
+		}
+
+		numOrder[OIDX] = numCombination;
+		endTime = WallClock();
+		printf("Thread %4u Finish\n", threadIdx);
+		FreeThreadMemory();
+	}
+
+	// count the contingency tables of the combination held in the words of order o + 1
+	void CountWords(uint32 o)
+	{
+		if (bits)
+		{
+			for (uint32 c = 0; c < (2u << o); c++)
+			{
+				contingencyCase[bti[c]] = (sampleIdx)(bitCountCase[o][c] - (c ? 0 : dataset->numBitCase * bit_in_word - dataset->numByteCase));
+				contingencyCtrl[bti[c]] = (sampleIdx)(bitCountCtrl[o][c] - (c ? 0 : dataset->numBitCtrl * bit_in_word - dataset->numByteCtrl));
+			}
+			return;
+		}
+
+		WordByte wb;
+		for (uint32 i = 0; i < dataset->numWordCase; i++)
+		{
+			wb.w = epiCaseWord[o][i];
+			for (uint32 b = 0; b < byte_in_word; b++)
+				contingencyCase[wb.b[b]]++;
+		}
+
+		for (uint32 i = 0; i < dataset->numWordCtrl; i++)
+		{
+			wb.w = epiCtrlWord[o][i];
+			for (uint32 b = 0; b < byte_in_word; b++)
+				contingencyCtrl[wb.b[b]]++;
+		}
+	}
+
+	// a combination of order o + 1 visited by the fused traversal, its contingency tables counted
+	void Visit(uint32 o, varIdx *idx)
+	{
+		double p = Gini(o);
+		numCombination++;
+		numOrder[o]++;
+
+		// the other metrics, before an IG recount reuses the contingency tables
+		if (args.metrics)
+			Metrics(o, idx);
+
+		// a -targets run only reports the SNPs that are targets
+		bool target = o || !numTarget || idx[0] < numTarget;
+		if (sketches && target)
+			AddSketch(o, OUT_PURITY, p);
+		if (args.printP[o] && target)
+			if (p >= args.p[o])
+				writers[o]->Push(threadIdx, OUT_PURITY, p, idx);
+
+		if (o < MAX_ORDER - 1 && args.saveP[o])
+			purity->Set(o, idx, p);
+
+		if (!args.computeIG[o] || !target)
+			return;
+		double ig = p - (o ? SubsetMax(purity, NUM_METRIC, o, idx) : dataset->setPurity);
+		if (sketches)
+			AddSketch(o, OUT_IG, ig);
+
+		if (args.printIG[o])
+			if (ig >= args.ig[o])
+				writers[o]->Push(threadIdx, OUT_IG, ig, idx);
+
+		if (args.bestIG)
+			results->Best(o, ig, p, idx);
+	}
+
+	// the combinations that start with idx[0..o], each one after all of its sub-combinations: the positions
+	// of every level go down, so the sub-combinations that replace a SNP by a later one come first
+	void Traverse(uint32 o, varIdx *idx)
+	{
+		bool visit = args.computeP[o] && (o || idx[0] < dataset->numVariable);
+		bool deeper = o < fusedTop && (o || idx[0] < FirstEnd(1));
+
+		if (deeper)
+		{
+			// the words of this level are kept for the next one and counted from there
+			if (o == 0)
+				OR_1(idx[0]);
+			else if (o == 1)
+				OR_2(idx[1]);
+			else
+				OR_3(idx[2]);
+			if (visit)
+			{
+				memset(contingencyCtrl, 0, (4 << (2 * o)) * sizeof(sampleIdx));
+				memset(contingencyCase, 0, (4 << (2 * o)) * sizeof(sampleIdx));
+				CountWords(o);
+				Visit(o, idx);
+			}
+		}
+		else if (visit)
+		{
+			memset(contingencyCtrl, 0, (4 << (2 * o)) * sizeof(sampleIdx));
+			memset(contingencyCase, 0, (4 << (2 * o)) * sizeof(sampleIdx));
+			CountLast(o, idx);
+			Visit(o, idx);
+		}
+
+		if (!deeper)
+			return;
+		for (idx[o + 1] = End(idx[0]); idx[o + 1]-- > Next(idx[o]);)
+			Traverse(o + 1, idx);
+	}
+
+	// the fused traversal (-fused): every order in one pass, the threads take the next first position from the queue
+	void Epi_Fused(uint32 id)
+	{
+		threadIdx = id;
+
+		BindThread();
+		AllocateThreadMemory();
+
+		printf("Thread %4u starting ...\n", threadIdx);
+
+		varIdx idx[MAX_ORDER];
+		while (!Stopped())
+		{
+			pthread_mutex_lock(&queue->lock);
+			bool more = queue->next > 0;
+			if (more)
+				idx[0] = --queue->next;
+			pthread_mutex_unlock(&queue->lock);
+			if (!more)
+				break;
+
+			Traverse(0, idx);
+#ifdef _MSC_VER
+			*(volatile bool *)&queue->done[idx[0]] = true;
+#else
+			__atomic_store_n(&queue->done[idx[0]], true, __ATOMIC_RELEASE);
 #endif
+		}
+
+
+		endTime = WallClock();
+		printf("Thread %4u Finish\n", threadIdx);
+		FreeThreadMemory();
+	}
+
+	// wait for the other threads of an order that splits the samples
+	void SplitWait()
+	{
+		pthread_mutex_lock(&split->lock);
+		uint32 generation = split->generation;
+		if (++split->waiting == args.numThreads)
+		{
+			split->waiting = 0;
+			split->generation++;
+			pthread_cond_broadcast(&split->cond);
+		}
+		else
+			while (generation == split->generation)
+				pthread_cond_wait(&split->cond, &split->lock);
+		pthread_mutex_unlock(&split->lock);
+	}
+
+	// the combination of order o + 1 after idx in the order of the kernels, false after the last one
+	bool NextCombination(uint32 o, varIdx *idx)
+	{
+		varIdx n = dataset->numVariable;
+		int32 k = (int32)o;
+		while (k >= 0 && idx[k] == n - 1 - (o - k))
+			k--;
+		if (k < 0)
+			return false;
+		idx[k]++;
+		for (uint32 j = k + 1; j <= o; j++)
+			idx[j] = idx[j - 1] + 1;
+		return true;
+	}
+
+	// every thread counts its share of the words of each combination, in batches, then reports a share of the batch
+	void Epi_Split(uint32 id)
+	{
+		const uint32 o = splitOrder;
+		threadIdx = id;
+
+		BindThread();
+		AllocateThreadMemory();
+
+		printf("Thread %4u starting ...\n", threadIdx);
+
+		uint32 t = args.numThreads;
+		uint32 caseBegin = (uint32)((uint64)dataset->numWordCase * threadIdx / t);
+		uint32 caseEnd = (uint32)((uint64)dataset->numWordCase * (threadIdx + 1) / t);
+		uint32 ctrlBegin = (uint32)((uint64)dataset->numWordCtrl * threadIdx / t);
+		uint32 ctrlEnd = (uint32)((uint64)dataset->numWordCtrl * (threadIdx + 1) / t);
+		uint32 entry = split->entry;
+
+		varIdx batch[SPLIT_BATCH][MAX_ORDER];
+		varIdx idx[MAX_ORDER];
+		for (uint32 k = 0; k <= o; k++)
+			idx[k] = k;
+		bool more = true;
+		while (more)
+		{
+			uint32 num = 0;
+			for (; num < SPLIT_BATCH && more; num++)
+			{
+				memcpy(batch[num], idx, sizeof(idx));
+				CountRange(idx, o + 1, caseBegin, caseEnd, ctrlBegin, ctrlEnd);
+				sampleIdx *partialCase = split->partialCase + ((uint64)threadIdx * SPLIT_BATCH + num) * entry;
+				sampleIdx *partialCtrl = split->partialCtrl + ((uint64)threadIdx * SPLIT_BATCH + num) * entry;
+				for (uint32 c = 0; c < entry; c++)
+				{
+					partialCase[c] = contingencyCase[cti[c]];
+					partialCtrl[c] = contingencyCtrl[cti[c]];
+				}
+				more = NextCombination(o, idx);
+			}
+			SplitWait();
+
+			for (uint32 j = threadIdx; j < num; j += t)
+			{
+				memset(contingencyCase, 0, (4 << (2 * o)) * sizeof(sampleIdx));
+				memset(contingencyCtrl, 0, (4 << (2 * o)) * sizeof(sampleIdx));
+				for (uint32 u = 0; u < t; u++)
+				{
+					const sampleIdx *partialCase = split->partialCase + ((uint64)u * SPLIT_BATCH + j) * entry;
+					const sampleIdx *partialCtrl = split->partialCtrl + ((uint64)u * SPLIT_BATCH + j) * entry;
+					for (uint32 c = 0; c < entry; c++)
+					{
+						contingencyCase[cti[c]] += partialCase[c];
+						contingencyCtrl[cti[c]] += partialCtrl[c];
+					}
+				}
+				Visit(o, batch[j]);
 			}
+
+			// the partial tables are counted again once every thread has reported its share
+			if (threadIdx == 0)
+				split->stopped = Stopped();
+			SplitWait();
+			if (split->stopped)
+				break;
 		}
 
+		endTime = WallClock();
 		printf("Thread %4u Finish\n", threadIdx);
 		FreeThreadMemory();
 	}
-	
-	void Epi_2(uint32 id)
-	{
-		const uint32 OIDX = 1; // Pair
-		threadIdx = id;
 
+	// Time the kernels of an order on the dataset and return the seconds per combination (used by -plan)
+	double Calibrate(uint32 o)
+	{
+		threadIdx = 0;
+		node = 0;
 		AllocateThreadMemory();
 
-		printf("Thread %4u starting ...\n", threadIdx);
-
-		varIdx idx[2];
-
-		for (idx[0] = 0; idx[0] < (dataset->numVariable - OIDX); idx[0]++)
+		varIdx n = dataset->numVariable;
+		varIdx idx[MAX_ORDER];
+		uint64 count = 0;
+		double sink = 0;
+		double begin = WallClock();
+		double elapsed;
+		do
 		{
-			uint32 pt = (idx[0] % args.numThreads);
-			if (pt == threadIdx)
+			for (idx[0] = 0; idx[0] < n - o; idx[0]++)
 			{
+				if (o == 0)
+				{
+					ResetContigencyTable_1();
+					OR_1x(idx[0]);
+					sink += Gini_1();
+					count++;
+					continue;
+				}
 				OR_1(idx[0]);
-				for (idx[1] = idx[0] + 1; idx[1] < dataset->numVariable; idx[1]++)
+				for (idx[1] = idx[0] + 1; idx[1] < n - (o - 1); idx[1]++)
 				{
-#ifdef PTEST
-					clock_t xc1 = clock();
-#endif
-					ResetContigencyTable_2();
-#ifdef PTEST
-					clock_t xc2 = clock();
-#endif
-					OR_2x(idx[1]);
-#ifdef PTEST
-					clock_t xc3 = clock();
-#endif
-					// compute purity
-					double p = Gini_2();
-#ifdef PTEST
-					clock_t xc4 = clock();
-#endif
-					// report SNP combination if purity meet threshold
-					if (args.printP[OIDX])
-						if (p >= args.p[OIDX])
-							fprintf(topPfile[threadIdx], "%f,%s,%s\n", p, dataset->nameVariable[idx[0]], dataset->nameVariable[idx[1]]);
+					if (o == 1)
+					{
+						ResetContigencyTable_2();
+						OR_2x(idx[1]);
+						sink += Gini_2();
+						count++;
+						continue;
+					}
+					OR_2(idx[1]);
+					for (idx[2] = idx[1] + 1; idx[2] < n - (o - 2); idx[2]++)
+					{
+						if (o == 2)
+						{
+							ResetContigencyTable_3();
+							OR_3x(idx[2]);
+							sink += Gini_3();
+							count++;
+							continue;
+						}
+						OR_3(idx[2]);
+						for (idx[3] = idx[2] + 1; idx[3] < n; idx[3]++)
+						{
+							ResetContigencyTable_4();
+							OR_4x(idx[3]);
+							sink += Gini_4();
+							count++;
+						}
+					}
+				}
+			}
+			elapsed = WallClock() - begin;
+		} while (elapsed < 0.2);
 
-					// Save Purity to compute IG of next order
-					if (args.saveP[OIDX])
-						PairPurity[idx[0]][idx[1]] = p;
+		FreeThreadMemory();
+		if (sink < 0) // keep the kernels from being optimised away
+			printf(" ");
+		return elapsed / count;
+	}
 
-					// compute Information Gained
-					if (args.computeIG[OIDX])
-					{
-						double max_p = (SnpPurity[idx[1]] > SnpPurity[idx[0]]) ? SnpPurity[idx[1]] : SnpPurity[idx[0]];
-		
-						double ig = p - max_p;
+	void MultiThread(void *(*threadFunction) (void *))
+	{
+		pthread_t *threads = new pthread_t[args.numThreads];
+		ThreadData *td = new ThreadData[args.numThreads];
+		for (uint32 i = 0; i < args.numThreads; i++)
+		{
+			td[i].epiStat = (void *) new EpiStat(this);
+			td[i].id = i;
+		}
+		for (uint32 i = 0; i < args.numThreads; i++)
+		{
+			pthread_create(&threads[i], NULL, threadFunction, &td[i]);
+		}
+		for (uint32 i = 0; i < args.numThreads; i++)
+		{
+			pthread_join(threads[i], NULL);
+		}
 
-						// report SNP combination if IG meet threshold
-						if (args.printIG[OIDX])
-							if (ig >= args.ig[OIDX])
-								fprintf(topIGfile[threadIdx], "%f,%s,%s\n", ig, dataset->nameVariable[idx[0]], dataset->nameVariable[idx[1]]);
+		uint64 pruned = 0;
+		for (uint32 i = 0; i < args.numThreads; i++)
+		{
+			pruned += ((EpiStat *)td[i].epiStat)->numPruned;
+			for (uint32 o = 0; o < MAX_ORDER; o++)
+				covered[o] += ((EpiStat *)td[i].epiStat)->numOrder[o];
+		}
+		if (pruned)
+			printf("\n%llu combinations stopped early", (unsigned long long)pruned);
 
-						// compute the best IG
-						if (args.bestIG)
-							dataset->results[threadIdx].Max_2(ig, p, idx);
-					}
-#ifdef PTEST
-					clock_t xc5 = clock();
-					elapse[1] += xc2 - xc1;
-					elapse[2] += xc3 - xc2;
-					elapse[3] += xc4 - xc3;
-					elapse[4] += xc5 - xc4;
-#endif
-				}
+		// throughput achieved on each NUMA node
+		for (uint32 n = 0; n < MAX_NODE; n++)
+		{
+			uint64 combinations = 0;
+			uint32 nodeThreads = 0;
+			double begin = 0;
+			double end = 0;
+			for (uint32 i = 0; i < args.numThreads; i++)
+			{
+				EpiStat *es = (EpiStat *)td[i].epiStat;
+				if (es->node != n)
+					continue;
+				if (nodeThreads == 0 || es->beginTime < begin) begin = es->beginTime;
+				if (nodeThreads == 0 || es->endTime > end) end = es->endTime;
+				combinations += es->numCombination;
+				nodeThreads++;
+			}
+			if (nodeThreads)
+			{
+				double seconds = end - begin;
+				printf("\nNode %u: %u threads, %llu combinations in %.3f seconds (%.3f M combinations/second)", n, nodeThreads, combinations, seconds, seconds > 0 ? combinations / seconds / 1e6 : 0.0);
 			}
 		}
-		printf("Thread %4u Finish\n", threadIdx);
-		FreeThreadMemory();
+
+		for (uint32 i = 0; i < args.numThreads; i++)
+			delete (EpiStat *)td[i].epiStat;
+		delete[] td;
+		delete[] threads;
 	}
 
-	void Epi_3(uint32 id)
+	// names of the variables in the run order
+	void MapNames()
 	{
-		const uint32 OIDX = 2; // Triplet
-		threadIdx = id;
+		varIdx n = dataset->numVariable;
+		names = new char *[n];
+		NULL_CHECK(names);
+		for (varIdx i = 0; i < n; i++)
+			names[i] = dataset->nameVariable[varMap[i]];
 
-		AllocateThreadMemory();
+		if (!dataset->alias)
+			return;
+		aliases = new char **[n];
+		NULL_CHECK(aliases);
+		for (varIdx i = 0; i < n; i++)
+			aliases[i] = dataset->alias[varMap[i]];
+	}
 
-		printf("Thread %4u starting ...\n", threadIdx);
+	// the variable of a name, also found by the other names of its set (-collapse), n if none
+	varIdx FindVariable(const char *name)
+	{
+		varIdx n = dataset->numVariable;
+		for (varIdx v = 0; v < n; v++)
+		{
+			if (!strcmp(name, dataset->nameVariable[v]))
+				return v;
+			for (uint32 m = 0; dataset->alias && dataset->alias[v] && dataset->alias[v][m]; m++)
+				if (!strcmp(name, dataset->alias[v][m]))
+					return v;
+		}
+		return n;
+	}
 
-		varIdx idx[3];
+	// put the targets (-targets) first in the run order, so that a combination includes a target when it starts with one,
+	// false if none of them is in the dataset
+	bool LoadTargets()
+	{
+		varIdx n = dataset->numVariable;
+		FILE *f = fopen(args.targets, "r");
+		if (!f)
+			INPUT_ERROR("Cannot open the targets file");
+
+		bool *isTarget = new bool[n];
+		NULL_CHECK(isTarget);
+		memset(isTarget, 0, n * sizeof(bool));
+		varMap = new varIdx[n];
+		NULL_CHECK(varMap);
+
+		char line[1024];
+		while (fgets(line, sizeof(line), f))
+		{
+			line[strcspn(line, "\r\n")] = 0;
+			if (!strlen(line))
+				continue;
+			varIdx v = FindVariable(line);
+			if (v == n)
+			{
+				printf("\n*** target %s is not in the dataset", line);
+				continue;
+			}
+			if (isTarget[v])
+				continue;
+			isTarget[v] = true;
+			varMap[numTarget++] = v;
+		}
+		fclose(f);
 
-		for (idx[0] = 0; idx[0] < (dataset->numVariable - OIDX); idx[0]++)
+		if (!numTarget)
 		{
-			uint32 pt = (idx[0] % args.numThreads);
-			if (pt == threadIdx)
+			delete[] isTarget;
+			delete[] varMap;
+			varMap = NULL;
+			INPUT_ERROR("None of the targets is in the dataset");
+		}
+
+		varIdx next = numTarget;
+		for (varIdx v = 0; v < n; v++)
+			if (!isTarget[v])
+				varMap[next++] = v;
+		delete[] isTarget;
+
+		MapNames();
+
+		printf("\n%u targets among %u SNPs\n", numTarget, n);
+		return true;
+	}
+
+	// sort the annotated SNPs (-annot) so that the SNPs a combination can hold are contiguous, unannotated SNPs go last and pair with none,
+	// false if the file cannot be opened
+	bool LoadAnnotations()
+	{
+		varIdx n = dataset->numVariable;
+		FILE *f = fopen(args.annot, "r");
+		if (!f)
+			INPUT_ERROR("Cannot open the annotation file");
+
+		NamedVariable *byName = new NamedVariable[n];
+		NULL_CHECK(byName);
+		for (varIdx v = 0; v < n; v++)
+		{
+			byName[v].name = dataset->nameVariable[v];
+			byName[v].var = v;
+		}
+		qsort(byName, n, sizeof(NamedVariable), CompareNamed);
+
+		char **chrom = new char *[n];
+		char **group = new char *[n];
+		uint64 *pos = new uint64[n];
+		NULL_CHECK(chrom);
+		NULL_CHECK(group);
+		NULL_CHECK(pos);
+		memset(chrom, 0, n * sizeof(char *));
+		memset(group, 0, n * sizeof(char *));
+
+		// name,chromosome,position[,group]; lines without a numeric position (a header) are skipped
+		char line[4096];
+		uint32 unknown = 0;
+		while (fgets(line, sizeof(line), f))
+		{
+			line[strcspn(line, "\r\n")] = 0;
+			char *field[4] = { line, NULL, NULL, NULL };
+			for (uint32 k = 1; k < 4; k++)
 			{
-				OR_1(idx[0]);
-				for (idx[1] = idx[0] + 1; idx[1] < (dataset->numVariable - (OIDX - 1)); idx[1]++)
-				{
-					OR_2(idx[1]);
-					for (idx[2] = idx[1] + 1; idx[2] < dataset->numVariable; idx[2]++)
-					{
-#ifdef PTEST
-						clock_t xc1 = clock();
-#endif
-						ResetContigencyTable_3();
-#ifdef PTEST
-						clock_t xc2 = clock();
-#endif
-						OR_3x(idx[2]);
-#ifdef PTEST
-						clock_t xc3 = clock();
-#endif
-						// compute purity
-						double p = Gini_3();
-#ifdef PTEST
-						clock_t xc4 = clock();
-#endif
-						// report SNP combination if purity meet threshold
-						if (args.printP[OIDX])
-							if (p >= args.p[OIDX])
-								fprintf(topPfile[threadIdx], "%f,%s,%s,%s\n", p, dataset->nameVariable[idx[0]], dataset->nameVariable[idx[1]], dataset->nameVariable[idx[2]]);
+				field[k] = strchr(field[k - 1], ',');
+				if (!field[k])
+					break;
+				*field[k]++ = 0;
+			}
+			if (!field[2])
+				continue;
+			char *end;
+			uint64 position = strtoull(field[2], &end, 10);
+			if (end == field[2] || *end)
+				continue;
 
-						// Save Purity to compute IG of next order
-						if (args.saveP[OIDX])
-							tripletPurity[idx[0]][idx[1]][idx[2]] = p;
+			NamedVariable key;
+			key.name = field[0];
+			NamedVariable *found = (NamedVariable *)bsearch(&key, byName, n, sizeof(NamedVariable), CompareNamed);
+			if (!found)
+			{
+				unknown++;
+				continue;
+			}
+			varIdx v = found->var;
+			delete[] chrom[v];
+			delete[] group[v];
+			chrom[v] = new char[strlen(field[1]) + 1];
+			strcpy(chrom[v], field[1]);
+			const char *g = field[3] ? field[3] : "";
+			group[v] = new char[strlen(g) + 1];
+			strcpy(group[v], g);
+			pos[v] = position;
+		}
+		fclose(f);
+		delete[] byName;
 
-						// compute Information Gained
-						if (args.computeIG[OIDX])
-						{
-							double max_p = (PairPurity[idx[0]][idx[1]] > PairPurity[idx[0]][idx[2]]) ? PairPurity[idx[0]][idx[1]] : PairPurity[idx[0]][idx[2]];
-							max_p = (PairPurity[idx[1]][idx[2]] > max_p) ? PairPurity[idx[1]][idx[2]] : max_p;
+		// sort keys: the blocks a combination stays in (group, chromosome), then the blocks it must cross
+		AnnotatedVariable *sorted = new AnnotatedVariable[n];
+		NULL_CHECK(sorted);
+		varIdx numAnnotated = 0;
+		for (varIdx v = 0; v < n; v++)
+		{
+			if (!chrom[v])
+				continue;
+			AnnotatedVariable &a = sorted[numAnnotated++];
+			a.var = v;
+			a.key[0] = args.sameGroup ? group[v] : "";
+			a.key[1] = (args.cis || args.maxDist) ? chrom[v] : "";
+			a.key[2] = args.trans ? chrom[v] : (args.crossGroup ? group[v] : "");
+			a.pos = pos[v];
+		}
+		qsort(sorted, numAnnotated, sizeof(AnnotatedVariable), CompareAnnotated);
+
+		varMap = new varIdx[n];
+		nextVar = new varIdx[n];
+		endVar = new varIdx[n];
+		NULL_CHECK(varMap);
+		NULL_CHECK(nextVar);
+		NULL_CHECK(endVar);
+
+		varIdx next = 0;
+		for (varIdx i = 0; i < numAnnotated; i++)
+			varMap[next++] = sorted[i].var;
+		for (varIdx v = 0; v < n; v++)
+			if (!chrom[v])
+				varMap[next++] = v;
+
+		// end of the block of each SNP, and of the block it must leave, computed from the back
+		for (varIdx i = numAnnotated; i-- > 0;)
+		{
+			bool sameBlock = (i + 1 < numAnnotated) && !strcmp(sorted[i].key[0], sorted[i + 1].key[0]) && !strcmp(sorted[i].key[1], sorted[i + 1].key[1]);
+			endVar[i] = sameBlock ? endVar[i + 1] : i + 1;
+			bool sameCross = sameBlock && !strcmp(sorted[i].key[2], sorted[i + 1].key[2]);
+			nextVar[i] = (args.trans || args.crossGroup) ? (sameCross ? nextVar[i + 1] : i + 1) : i + 1;
+		}
 
-							double ig = p - max_p;
+		// window of -maxDist, positions are sorted within a block
+		if (args.maxDist)
+		{
+			varIdx j = 0;
+			for (varIdx i = 0; i < numAnnotated; i++)
+			{
+				if (j < i + 1)
+					j = i + 1;
+				while (j < endVar[i] && sorted[j].pos - sorted[i].pos <= args.maxDist)
+					j++;
+				endVar[i] = j;
+			}
+		}
 
-							// report SNP combination if IG meet threshold
-							if (args.printIG[OIDX])
-								if (ig >= args.ig[OIDX])
-									fprintf(topIGfile[threadIdx], "%f,%s,%s,%s\n", ig, dataset->nameVariable[idx[0]], dataset->nameVariable[idx[1]], dataset->nameVariable[idx[2]]);
+		for (varIdx i = numAnnotated; i < n; i++)
+		{
+			nextVar[i] = i + 1;
+			endVar[i] = i + 1;
+		}
 
-							// compute the best IG
-							if (args.bestIG)
-								dataset->results[threadIdx].Max_3(ig, p, idx);
-						}
-#ifdef PTEST
-						clock_t xc5 = clock();
-						elapse[1] += xc2 - xc1;
-						elapse[2] += xc3 - xc2;
-						elapse[3] += xc4 - xc3;
-						elapse[4] += xc5 - xc4;
-#endif
-					}
+		MapNames();
+
+		for (varIdx v = 0; v < n; v++)
+		{
+			delete[] chrom[v];
+			delete[] group[v];
+		}
+		delete[] chrom;
+		delete[] group;
+		delete[] pos;
+		delete[] sorted;
+
+		printf("\n%u of %u SNPs annotated", numAnnotated, n);
+		if (unknown)
+			printf("\n*** %u annotated SNPs are not in the dataset", unknown);
+		printf("\n");
+		return true;
+	}
+
+	// give each thread a similar share of the combinations of an order, from the number that start at each position
+	void Partition(uint32 order)
+	{
+		varIdx n = dataset->numVariable;
+		WorkItem *items = new WorkItem[n];
+		NULL_CHECK(items);
+		double total = 0;
+		for (varIdx i = 0; i < n; i++)
+		{
+			items[i].first = i;
+			items[i].work = (order == 0) ? 1 : Combinations(End(i) - Next(i), order);
+			total += items[i].work;
+		}
+		qsort(items, n, sizeof(WorkItem), CompareWork);
+
+		// largest first, each to the thread with the least work so far
+		double *load = new double[args.numThreads];
+		NULL_CHECK(load);
+		memset(load, 0, args.numThreads * sizeof(double));
+		for (varIdx i = 0; i < n; i++)
+		{
+			uint32 least = 0;
+			for (uint32 t = 1; t < args.numThreads; t++)
+				if (load[t] < load[least])
+					least = t;
+			owner[items[i].first] = least;
+			load[least] += items[i].work;
+		}
+
+		double most = 0;
+		for (uint32 t = 0; t < args.numThreads; t++)
+			most = (load[t] > most) ? load[t] : most;
+		printf("\nConstrained %u-SNP space: %.0f of %.0f combinations (at most %.0f per thread)\n", order + 1, total, Combinations(n, order + 1), most);
+
+		delete[] items;
+		delete[] load;
+	}
+
+	// number of combinations of order o + 1 the run enumerates, the windows of -annot counted position by position
+	double Space(uint32 o)
+	{
+		varIdx n = dataset->numVariable;
+		if (o == 0)
+			return n;
+		if (firstNew[o]) // -resume: the combinations with a new SNP
+			return Combinations(n, o + 1) - Combinations(firstNew[o], o + 1);
+
+		// ways[k][p]: combinations of k + 1 positions from p on within the window of the first position
+		double *ways[MAX_ORDER - 1];
+		memset(ways, 0, sizeof(ways));
+		for (uint32 k = 0; k < o && nextVar; k++)
+		{
+			ways[k] = new double[n + 1];
+			NULL_CHECK(ways[k]);
+		}
+
+		double total = 0;
+		for (varIdx f = 0; f < FirstEnd(o); f++)
+		{
+			varIdx begin = Next(f);
+			varIdx end = End(f);
+			if (begin >= end)
+				continue;
+			if (!nextVar)
+			{
+				total += Combinations(end - begin, o);
+				continue;
+			}
+			for (uint32 k = 0; k < o; k++)
+			{
+				ways[k][end] = 0;
+				for (varIdx p = end; p-- > begin;)
+				{
+					double here = k ? (Next(p) < end ? ways[k - 1][Next(p)] : 0) : 1;
+					ways[k][p] = ways[k][p + 1] + here;
 				}
 			}
+			total += ways[o - 1][begin];
+		}
+
+		for (uint32 k = 0; k < o; k++)
+			delete[] ways[k];
+		return total;
+	}
+
+	// the fraction of the combinations of each order the run processed (-timeBudget), false if any is short
+	bool WriteCoverage(bool write)
+	{
+		FILE *f = NULL;
+		if (write)
+		{
+			char *fn = new char[strlen(args.output) + 20];
+			NULL_CHECK(fn);
+			sprintf(fn, "%s.coverage.csv", args.output);
+			f = fopen(fn, "w");
+			NULL_CHECK(f);
+			delete[] fn;
+			fprintf(f, "ORDER,COMBINATIONS,TOTAL,FRACTION\n");
+		}
+
+		bool complete = true;
+		for (uint32 o = 0; o < MAX_ORDER; o++)
+		{
+			if (!args.computeP[o])
+				continue;
+			double total = Space(o);
+			double fraction = total ? covered[o] / total : 1;
+			complete = complete && covered[o] >= total;
+			printf("\n%u-SNP combinations covered: %llu of %.0f (%.6f%%)", o + 1, (unsigned long long)covered[o], total, 100 * fraction);
+			if (f)
+				fprintf(f, "%u,%llu,%.0f,%.10g\n", o + 1, (unsigned long long)covered[o], total, fraction);
+		}
+		if (f)
+			fclose(f);
+		return complete;
+	}
+
+	void FreeOrder()
+	{
+		if (!varMap)
+			return;
+		delete[] varMap;
+		delete[] names;
+		if (aliases != dataset->alias)
+			delete[] aliases;
+		delete[] nextVar;
+		delete[] endVar;
+		delete[] owner;
+		delete previous;
+		varMap = NULL;
+		names = dataset->nameVariable;
+		aliases = dataset->alias;
+		numTarget = 0;
+		nextVar = NULL;
+		endVar = NULL;
+		owner = NULL;
+		previous = NULL;
+		numOld = 0;
+		memset(firstNew, 0, sizeof(firstNew));
+	}
+
+	// put the SNPs of an earlier run (-resume) first in the run order and read its bestIG results, so that the run
+	// only adds the combinations that include one of the new SNPs after them, false if the state does not fit the dataset
+	bool LoadState()
+	{
+		varIdx n = dataset->numVariable;
+		FILE *f = fopen(args.resume, "rb");
+		if (!f)
+			INPUT_ERROR("Cannot open the state file");
+
+		StateHeader header;
+		const char *error = NULL;
+		if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, "BITEPIST", 8))
+			error = "Not a state file";
+		else if (header.numVariable > n || !header.nameBytes)
+			error = "The state has more SNPs than the dataset";
+		else if (header.numCase != dataset->numCase || header.numCtrl != dataset->numCtrl)
+			error = "The samples of the dataset differ from the state";
+		else if (header.bestK < args.bestK)
+			error = "The state keeps fewer combinations of each SNP than -bestIG";
+		if (error)
+		{
+			fclose(f);
+			INPUT_ERROR(error);
+		}
+		numOld = (varIdx)header.numVariable;
+
+		char *stateNames = new char[header.nameBytes];
+		uint64 *hash = new uint64[numOld];
+		NULL_CHECK(stateNames);
+		NULL_CHECK(hash);
+		previous = new Result();
+		NULL_CHECK(previous);
+		previous->Init(numOld, (uint32)header.bestK);
+		if (fread(stateNames, 1, header.nameBytes, f) != header.nameBytes || stateNames[header.nameBytes - 1]
+			|| fread(hash, sizeof(uint64), numOld, f) != numOld || !previous->Read(f))
+			error = "The state file is not complete";
+		fclose(f);
+
+		NamedVariable *byName = new NamedVariable[n];
+		NULL_CHECK(byName);
+		for (varIdx v = 0; v < n; v++)
+		{
+			byName[v].name = dataset->nameVariable[v];
+			byName[v].var = v;
+		}
+		qsort(byName, n, sizeof(NamedVariable), CompareNamed);
+
+		bool *isOld = new bool[n];
+		NULL_CHECK(isOld);
+		memset(isOld, 0, n * sizeof(bool));
+		varMap = new varIdx[n];
+		NULL_CHECK(varMap);
+
+		// the SNPs of the state keep their positions, so the results of the state are indexed by run position
+		char *name = stateNames;
+		for (varIdx i = 0; i < numOld && !error; i++, name += strlen(name) + 1)
+		{
+			if (name >= stateNames + header.nameBytes)
+			{
+				error = "The state file is not complete";
+				break;
+			}
+			NamedVariable key;
+			key.name = name;
+			NamedVariable *found = (NamedVariable *)bsearch(&key, byName, n, sizeof(NamedVariable), CompareNamed);
+			if (!found || isOld[found->var])
+			{
+				printf("\n*** SNP %s of the state", name);
+				error = "A SNP of the state is not in the dataset";
+				break;
+			}
+			if (dataset->VariableHash(found->var) != hash[i])
+			{
+				printf("\n*** SNP %s of the state", name);
+				error = "The genotypes or samples of a SNP differ from the state";
+				break;
+			}
+			isOld[found->var] = true;
+			varMap[i] = found->var;
+		}
+		varIdx next = numOld;
+		for (varIdx v = 0; v < n && !error; v++)
+			if (!isOld[v])
+				varMap[next++] = v;
+		delete[] isOld;
+		delete[] byName;
+		delete[] hash;
+		delete[] stateNames;
+		if (error)
+		{
+			delete[] varMap;
+			delete previous;
+			varMap = NULL;
+			previous = NULL;
+			numOld = 0;
+			INPUT_ERROR(error);
 		}
-		printf("Thread %4u Finish\n", threadIdx);
-		FreeThreadMemory();
-	}
 
-	void Epi_4(uint32 id)
-	{
-		const uint32 OIDX = 3; // Quadlet
-		threadIdx = id;
+		MapNames();
 
-		AllocateThreadMemory();
+		// the saved orders count every combination for the IG of the next one
+		for (uint32 o = 0; o < MAX_ORDER; o++)
+			firstNew[o] = (o == MAX_ORDER - 1 || !args.saveP[o]) ? numOld : 0;
 
-		printf("Thread %4u starting ...\n", threadIdx);
+		printf("\n%u new SNPs after the %u SNPs of the state\n", n - numOld, numOld);
+		return true;
+	}
 
-		varIdx idx[4];
+	// the SNPs and bestIG results of the run in the dataset order, for a later run on more SNPs (-resume)
+	void SaveState(Result *best)
+	{
+		varIdx n = dataset->numVariable;
+		StateHeader header;
+		memcpy(header.magic, "BITEPIST", 8);
+		header.numVariable = n;
+		header.numCase = dataset->numCase;
+		header.numCtrl = dataset->numCtrl;
+		header.bestK = best->k;
+		header.nameBytes = 0;
+		for (varIdx v = 0; v < n; v++)
+			header.nameBytes += strlen(dataset->nameVariable[v]) + 1;
+
+		// written to a temporary file first, like the purity cache
+		char *tmp = new char[strlen(args.saveState) + 10];
+		NULL_CHECK(tmp);
+		sprintf(tmp, "%s.tmp", args.saveState);
+		FILE *f = fopen(tmp, "wb");
+		bool written = f && fwrite(&header, sizeof(header), 1, f) == 1;
+		for (varIdx v = 0; v < n && written; v++)
+			written = fwrite(dataset->nameVariable[v], 1, strlen(dataset->nameVariable[v]) + 1, f) == strlen(dataset->nameVariable[v]) + 1;
+		for (varIdx v = 0; v < n && written; v++)
+		{
+			uint64 h = dataset->VariableHash(v);
+			written = fwrite(&h, sizeof(h), 1, f) == 1;
+		}
+		written = written && best->Write(f);
+		if (f && fclose(f))
+			written = false;
+		if (written && !rename(tmp, args.saveState))
+			printf("\nSaved the state of the run to %s", args.saveState);
+		else
+		{
+			printf("\n*** Cannot save the state of the run to %s", args.saveState);
+			remove(tmp);
+		}
+		delete[] tmp;
+	}
 
-		for (idx[0] = 0; idx[0] < (dataset->numVariable - OIDX); idx[0]++)
+	// whether the threads of order o split the samples of each combination rather than its first positions (-split)
+	bool SplitsSamples(uint32 o)
+	{
+		// the kernels keep the runs that restrict or reorder the combinations, or count them differently
+		if (args.split == SPLIT_SNPS || args.numThreads < 2 || dataset->numVariable <= o)
+			return false;
+		if (numTarget || nextVar || endVar || owner || numOld || counts || prune[o])
+			return false;
+		if (args.split == SPLIT_SAMPLES)
+			return true;
+		if (dataset->numWordCase + dataset->numWordCtrl < SPLIT_MIN_WORDS * args.numThreads)
+			return false;
+
+		// the combinations of each thread, C(n - 1 - i, o) start at first position i
+		double *load = new double[args.numThreads];
+		NULL_CHECK(load);
+		memset(load, 0, args.numThreads * sizeof(double));
+		varIdx n = dataset->numVariable;
+		double total = 0;
+		for (varIdx i = 0; i + o < n; i++)
 		{
-			uint32 pt = (idx[0] % args.numThreads);
-			if (pt == threadIdx)
-			{
-				OR_1(idx[0]);
-				for (idx[1] = idx[0] + 1; idx[1] < (dataset->numVariable - (OIDX - 1)); idx[1]++)
-				{
-					OR_2(idx[1]);
-					for (idx[2] = idx[1] + 1; idx[2] < (dataset->numVariable - (OIDX - 2)); idx[2]++)
-					{
-						OR_3(idx[2]);
-						for (idx[3] = idx[2] + 1; idx[3] < dataset->numVariable; idx[3]++)
-						{
-#ifdef PTEST
-							clock_t xc1 = clock();
-#endif
-							ResetContigencyTable_4();
-#ifdef PTEST
-							clock_t xc2 = clock();
-#endif
-							OR_4x(idx[3]);
-#ifdef PTEST
-							clock_t xc3 = clock();
-#endif
-							// compute purity
-							double p = Gini_4();
-#ifdef PTEST
-							clock_t xc4 = clock();
-#endif
+			double c = 1;
+			for (uint32 k = 0; k < o; k++)
+				c = c * (n - 1 - i - k) / (k + 1);
+			load[Owner(i)] += c;
+			total += c;
+		}
+		double most = 0;
+		for (uint32 t = 0; t < args.numThreads; t++)
+			most = load[t] > most ? load[t] : most;
+		delete[] load;
+		return most > SPLIT_IMBALANCE * total / args.numThreads;
+	}
 
-							// report SNP combination if purity meet threshold
-							if (args.printP[OIDX])
-								if (p >= args.p[OIDX])
-									fprintf(topPfile[threadIdx], "%f,%s,%s,%s,%s\n", p, dataset->nameVariable[idx[0]], dataset->nameVariable[idx[1]], dataset->nameVariable[idx[2]], dataset->nameVariable[idx[3]]);
+	// run the threads of order o on their share of the samples of every combination
+	void MultiSplit(uint32 o)
+	{
+		printf("Threads split the samples of each %u-SNP combination\n", o + 1);
+
+		SampleSplit s;
+		pthread_mutex_init(&s.lock, NULL);
+		pthread_cond_init(&s.cond, NULL);
+		s.waiting = 0;
+		s.generation = 0;
+		s.stopped = false;
+		s.entry = (uint32)pow(3, o + 1);
+		s.partialCase = new sampleIdx[(uint64)args.numThreads * SPLIT_BATCH * s.entry];
+		s.partialCtrl = new sampleIdx[(uint64)args.numThreads * SPLIT_BATCH * s.entry];
+		NULL_CHECK(s.partialCase);
+		NULL_CHECK(s.partialCtrl);
+		split = &s;
+		splitOrder = o;
+
+		MultiThread(splitFunction);
+
+		split = NULL;
+		delete[] s.partialCase;
+		delete[] s.partialCtrl;
+		pthread_cond_destroy(&s.cond);
+		pthread_mutex_destroy(&s.lock);
+	}
 
-							// compute Information Gained
-							if (args.computeIG[OIDX])
-							{
-								double max_p = (tripletPurity[idx[0]][idx[1]][idx[2]] > tripletPurity[idx[0]][idx[1]][idx[3]]) ? tripletPurity[idx[0]][idx[1]][idx[2]] : tripletPurity[idx[0]][idx[1]][idx[3]];
-								max_p = (tripletPurity[idx[0]][idx[2]][idx[3]] > max_p) ? tripletPurity[idx[0]][idx[2]][idx[3]] : max_p;
-								max_p = (tripletPurity[idx[1]][idx[2]][idx[3]] > max_p) ? tripletPurity[idx[1]][idx[2]][idx[3]] : max_p;
+	// every requested order in one traversal (-fused), with the writers of all orders open at once
+	void RunFused()
+	{
+		fusedTop = 0;
+		for (uint32 o = 0; o < MAX_ORDER; o++)
+			if (args.computeP[o])
+				fusedTop = o;
+
+		time_t begin = time(NULL);
+		printf("\n\n>>>>>>>>>> Process 1 to %u-SNP combinations in one traversal\n", fusedTop + 1);
+
+		FusedQueue q;
+		pthread_mutex_init(&q.lock, NULL);
+		q.next = dataset->numVariable;
+		q.done = new bool[dataset->numVariable];
+		NULL_CHECK(q.done);
+		memset(q.done, 0, dataset->numVariable * sizeof(bool));
+		queue = &q;
+
+		for (uint32 o = 0; o <= fusedTop; o++)
+			if (args.computeP[o])
+				OpenFiles(o);
+		MultiThread(fusedFunction);
+		for (uint32 o = 0; o <= fusedTop; o++)
+		{
+			if (!writers[o])
+				continue;
+			writer = writers[o];
+			CloseFiles(o);
+		}
 
-								double ig = p - max_p;
+		queue = NULL;
+		delete[] q.done;
+		pthread_mutex_destroy(&q.lock);
 
-								// report SNP combination if IG meet threshold
-								if (args.printIG[OIDX])
-									if (ig >= args.ig[OIDX])
-										fprintf(topIGfile[threadIdx], "%f,%s,%s,%s,%s\n", ig, dataset->nameVariable[idx[0]], dataset->nameVariable[idx[1]], dataset->nameVariable[idx[2]], dataset->nameVariable[idx[3]]);
+		time_t end = time(NULL);
+		printf("\n\n<<<<<<<<< Prosess 1 to %u-SNP combinations takes %10.0f seconds\n\n", fusedTop + 1, difftime(end, begin));
+	}
 
-								// compute the best IG
-								if (args.bestIG)
-									dataset->results[threadIdx].Max_4(ig, p, idx);
-							}
-#ifdef PTEST
-							clock_t xc5 = clock();
-							elapse[1] += xc2 - xc1;
-							elapse[2] += xc3 - xc2;
-							elapse[3] += xc4 - xc3;
-							elapse[4] += xc5 - xc4;
-#endif
-						}
-					}
+	int Run()
+	{
+		volatile bool stopped = false;
+		stop = &stopped;
+		deadline = args.timeBudget ? WallClock() + args.timeBudget : 0;
+
+		// a run in its own order saves its purities in that order, a -targets run only the sub-combinations that start with a target
+		PurityTable ownPurity;
+		if (args.OwnPurity())
+		{
+			bool loaded = true;
+			if (strlen(args.targets))
+				loaded = LoadTargets();
+			else if (strlen(args.resume))
+				loaded = LoadState();
+			else if (strlen(args.annot))
+			{
+				loaded = LoadAnnotations();
+				if (loaded)
+				{
+					owner = new uint32[dataset->numVariable];
+					NULL_CHECK(owner);
 				}
 			}
+			if (!loaded)
+				return RETURN_INVALID;
+			ownPurity.Allocate(dataset->numVariable, numTarget ? numTarget : dataset->numVariable, args);
+			purity = &ownPurity;
 		}
 
-		printf("Thread %4u Finish\n", threadIdx);
-		FreeThreadMemory();
-	}
+		CountTable countTable;
+		if (strlen(args.counts))
+		{
+			if (!countTable.Open(args.counts, dataset))
+				return RETURN_INVALID;
+			counts = &countTable;
+		}
 
-	void MultiThread(void *(*threadFunction) (void *))
-	{
-		pthread_t *threads = new pthread_t[args.numThreads];
-		ThreadData *td = new ThreadData[args.numThreads];
-		for (uint32 i = 0; i < args.numThreads; i++)
+		CarrierList carrierList;
+		if (args.sparse && bits)
+			printf("\n-sparse is not used with binary genotypes, the bit kernel counts every combination");
+		else if (args.sparse)
 		{
-			td[i].epiStat = (void *) new EpiStat(this);
-			td[i].id = i;
+			carrierList.Build(dataset, args.sparse);
+			carriers = &carrierList;
 		}
-		for (uint32 i = 0; i < args.numThreads; i++)
+
+		if (args.bestIG)
 		{
-			pthread_create(&threads[i], NULL, threadFunction, &td[i]);
+			results = new Result();
+			NULL_CHECK(results);
+			results->Init(dataset->numVariable, args.bestK);
+			if (previous)
+				results->varMap = varMap;
 		}
-		for (uint32 i = 0; i < args.numThreads; i++)
+
+		if (args.sketch)
+			AllocateSketches();
+
+		// -early counts in blocks of at least EARLY_BLOCK_SAMPLES samples, and needs two of them
+		earlyBlocks = (uint32)((dataset->numByteCase + dataset->numByteCtrl) / EARLY_BLOCK_SAMPLES);
+		earlyBlocks = earlyBlocks > EARLY_BLOCKS ? EARLY_BLOCKS : earlyBlocks;
+		for (uint32 o = 0; o < MAX_ORDER; o++)
+			prune[o] = !bits && earlyBlocks > 1 && args.Prunes(o);
+
+		// the other metrics keep their values in tables of their own for this run only
+		PurityTable ownMetric[NUM_METRIC];
+		for (uint32 k = 0; k < NUM_METRIC; k++)
 		{
-			pthread_join(threads[i], NULL);
+			ARGS metricArgs = args;
+			for (uint32 o = 0; o < MAX_ORDER; o++)
+				metricArgs.saveP[o] = args.saveM[k][o];
+			ownMetric[k].Allocate(dataset->numVariable, numTarget ? numTarget : dataset->numVariable, metricArgs);
+			metricTable[k] = &ownMetric[k];
+
+			if (!args.bestM[k])
+				continue;
+			metricResults[k] = new Result();
+			NULL_CHECK(metricResults[k]);
+			metricResults[k]->Init(dataset->numVariable, args.bestK);
 		}
 
-		
-	}
+		if (args.fused)
+			RunFused();
 
-	void Run()
-	{
-		for (int i = 0; i < MAX_ORDER; i++)
+		for (int i = 0; i < MAX_ORDER && !args.fused; i++)
 		{
+			if (*cancel || *stop)
+				break;
 			if (args.computeP[i])
 			{
 				time_t begin = time(NULL);
 				printf("\n\n>>>>>>>>>> Process %u-SNP combinations\n", i + 1);
 
+				if (owner)
+					Partition(i);
 				OpenFiles(i);
-				MultiThread(threadFunction[i]);
+				if (SplitsSamples(i))
+					MultiSplit(i);
+				else
+					MultiThread(threadFunction[i]);
 				CloseFiles(i);
 
 				time_t end = time(NULL);
@@ -1586,71 +6823,251 @@ public:
 				printf("\n\n<<<<<<<<< Prosess %u-SNP combinations takes %10.0f seconds\n\n", i+1, time_spent);
 			}
 		}
-		// merge thread files
-		#ifndef _MSC_VER
+
+		if (*cancel)
 		{
-			char* cmd = new char[1024];
-			NULL_CHECK(cmd);
-			for (uint32 order = 0; order < MAX_ORDER; order++)
-			{
-				char header[1024];
-				switch (order)
-				{
-				case 0:	sprintf(header, "SNP_A"); break;
-				case 1:	sprintf(header, "SNP_A,SNP_B"); break;
-				case 2:	sprintf(header, "SNP_A,SNP_B,SNP_C"); break;
-				case 3:	sprintf(header, "SNP_A,SNP_B,SNP_C,SNP_D"); break;
-				}
+			printf("\n\n*** Cancelled, removing thread files\n");
+		for (uint32 o = 0; o < MAX_ORDER; o++)
+				delete writers[o];
+			RemoveFiles();
+			counts = NULL;
+			carriers = NULL;
+			delete results;
+			for (uint32 k = 0; k < NUM_METRIC; k++)
+				delete metricResults[k];
+			FreeSketches();
+			FreeOrder();
+			return RETURN_CANCELLED;
+		}
+		if (*stop)
+			printf("\n\n*** Stopped, writing the results so far\n");
 
-				char sortCmd[100];
-				if (args.sort)
-					sprintf(sortCmd, "%s", "| sort -g -r -k1,1 -t ','");
-				else
-					sprintf(sortCmd, " ");
+		// a run stopped as its last work unit finished is complete
+		bool complete = true;
+		if (args.timeBudget || *stop)
+			complete = WriteCoverage(args.timeBudget || *stop);
 
-				if (args.printP[order])
-				{
-					// create a merged output file
-					sprintf(cmd, "cat %s.Purity.%u.*.csv %s | awk 'BEGIN{print(\"Purity,%s\")}{print}' > %s.Purity.%u.csv", args.output, order, sortCmd, header, args.output, order);
-					printf("\n>>> %s\n", cmd);
-					if (system(cmd) == -1)
-						ERROR("Cannot merge output files");
-					sprintf(cmd, "rm %s.Purity.%u.*.csv", args.output, order);
-					printf("\n>>> %s\n", cmd);
-					if (system(cmd) == -1)
-						ERROR("Cannot delete temp files");
-				}
-				if (args.printIG[order])
-				{
-					// create a merged output file
-					sprintf(cmd, "cat %s.IG.%u.*.csv %s | awk 'BEGIN{print(\"IG,%s\")}{print}' > %s.IG.%u.csv", args.output, order, sortCmd, header, args.output, order);
-					printf("\n>>> %s\n", cmd);
-					if (system(cmd) == -1)
-						ERROR("Cannot merge output files");
-					sprintf(cmd, "rm %s.IG.%u.*.csv", args.output, order);
-					printf("\n>>> %s\n", cmd);
-					if (system(cmd) == -1)
-						ERROR("Cannot delete temp files");
-				}
-			}
-			delete[]cmd;
+		// merge thread files, a streamed run has none
+		for (uint32 order = 0; order < MAX_ORDER; order++)
+		{
+			if (!writers[order])
+				continue;
+			for (uint32 m = 0; m < NUM_OUT; m++)
+				if (args.Prints(m, order) && !stream)
+					writers[order]->Merge(m);
+			delete writers[order];
 		}
-		#endif
 		if (args.bestIG)
 		{
-			printf("\n\nAggregate result from threads\n");
-			for (uint32 i = 1; i < args.numThreads; i++)
-				dataset->results[0].Max(dataset->results[i]);
+			// a resumed run adds the combinations with a new SNP to those of the state, in the dataset order
+			Result *best = results;
+			if (previous)
+			{
+				best = new Result();
+				NULL_CHECK(best);
+				best->Init(dataset->numVariable, args.bestK);
+				best->Merge(previous, varMap);
+				best->Merge(results, varMap);
+			}
 
 			char* fn = new char[strlen(args.output) + 20];
 			NULL_CHECK(fn);
 			sprintf(fn, "%s.bestIG.csv", args.output);
-			dataset->results->toCSV(fn, dataset->nameVariable);
+			best->toCSV(fn, previous ? dataset->nameVariable : names, previous ? dataset->alias : aliases, "P", "IG");
+			delete[]fn;
+
+			if (strlen(args.saveState) && complete)
+				SaveState(best);
+			if (best != results)
+				delete best;
+		}
+
+		for (uint32 k = 0; k < NUM_METRIC; k++)
+		{
+			if (!args.bestM[k])
+				continue;
+			char* fn = new char[strlen(args.output) + 30];
+			NULL_CHECK(fn);
+			sprintf(fn, "%s.bestIG.%s.csv", args.output, metricName[k]);
+			char gain[32];
+			sprintf(gain, "%s_GAIN", metricName[k]);
+			metricResults[k]->toCSV(fn, names, aliases, metricName[k], gain);
 			delete[]fn;
+			delete metricResults[k];
+		}
+
+		if (sketches)
+			WriteSketches();
+		FreeSketches();
+
+		// the count file only takes a batch that was counted in full
+		if (counts && complete)
+			counts->Store(args.counts);
+		counts = NULL;
+		carriers = NULL;
+
+		delete results;
+		FreeOrder();
+		return complete ? 0 : RETURN_STOPPED;
+	}
+};
+
+#define PLAN_VARIABLE 24 // number of synthetic variables used to calibrate the kernels
+
+// Predict the memory and run time of a job from the dimensions of its dataset (-plan)
+class Planner
+{
+	FILE *csv;
+
+	void Row(const char *section, const char *name, double value)
+	{
+		fprintf(csv, "%s,%s,%.10g\n", section, name, value);
+	}
+
+	void Row(const char *section, const char *name, const char *value)
+	{
+		fprintf(csv, "%s,%s,%s\n", section, name, value);
+	}
+
+	double Bytes(double b)
+	{
+		return b / (1024.0 * 1024.0 * 1024.0);
+	}
+
+public:
+	// false if the dataset cannot be read
+	bool Run(ARGS args)
+	{
+		char name[64];
+
+		Dataset dataset;
+		dataset.pageMode = args.hugePages;
+		if (!dataset.ReadDimensions(args.input))
+		{
+			dataset.FreeMemory();
+			return false;
+		}
+		double n = dataset.numVariable;
+		uint32 threads = args.numThreads;
+
+		Placement topology;
+		topology.Detect();
+		uint32 cpus = topology.numCpu;
+		double available = 0;
+#ifdef _MSC_VER
+		if (cpus == 0) cpus = 1;
+#else
+		if (cpus == 0) cpus = (uint32)sysconf(_SC_NPROCESSORS_ONLN);
+		available = (double)sysconf(_SC_PHYS_PAGES) * (double)sysconf(_SC_PAGE_SIZE);
+#endif
+
+		char *fn = new char[strlen(args.output) + 20];
+		NULL_CHECK(fn);
+		sprintf(fn, "%s.plan.csv", args.output);
+		csv = fopen(fn, "w");
+		NULL_CHECK(csv);
+		delete[] fn;
+		fprintf(csv, "SECTION,NAME,VALUE\n");
+
+		printf("\n\n>>>>>>>>>> Plan for %s\n", args.input);
+		printf("\n %u SNPs, %u samples (%u cases, %u controls), %u threads, %u cpus, %u NUMA nodes", (uint32)n, dataset.numSample, dataset.numCase, dataset.numCtrl, threads, cpus, topology.numNode);
+		Row("dataset", "snps", n);
+		Row("dataset", "samples", dataset.numSample);
+		Row("dataset", "cases", dataset.numCase);
+		Row("dataset", "controls", dataset.numCtrl);
+		Row("machine", "cpus", cpus);
+		Row("machine", "numa_nodes", topology.numNode);
+		Row("machine", "memory", available);
+
+		// memory of each structure
+		double total = 0;
+		double genotype = (n + 1) * (dataset.numByteCase + dataset.numByteCtrl);
+		if (args.numa && topology.numNode > 1)
+			genotype *= topology.numNode + 1;
+		double threadMemory = threads * ((MAX_ORDER - 1) * (dataset.numByteCase + dataset.numByteCtrl) + 2 * pow(2, MAX_ORDER * 2) * sizeof(sampleIdx));
+		if (args.sketch)
+			for (uint32 o = 0; o < MAX_ORDER; o++)
+				threadMemory += threads * 2 * Sketch::Bytes(Combinations(n, o + 1) / threads);
+		// the other metrics have bestIG results and saved tables of their own
+		double numBest = args.bestIG ? 1 : 0;
+		double numTable[MAX_ORDER - 1];
+		for (uint32 o = 0; o < MAX_ORDER - 1; o++)
+			numTable[o] = args.saveP[o] ? 1 : 0;
+		for (uint32 k = 0; k < NUM_METRIC; k++)
+		{
+			numBest += args.bestM[k] ? 1 : 0;
+			for (uint32 o = 0; o < MAX_ORDER - 1; o++)
+				numTable[o] += args.saveM[k][o] ? 1 : 0;
+		}
+		double results = numBest * Result::Bytes(n, args.bestK);
+		double purity[MAX_ORDER - 1];
+		purity[0] = numTable[0] * n * sizeof(double);
+		purity[1] = numTable[1] * (n * sizeof(double *) + n * n * sizeof(double));
+		purity[2] = numTable[2] * (n * sizeof(double **) + n * n * sizeof(double *) + n * n * n * sizeof(double));
+
+		printf("\n\n Memory (GB)");
+		printf("\n  genotype        %12.3f", Bytes(genotype));
+		printf("\n  thread buffers  %12.3f", Bytes(threadMemory));
+		printf("\n  bestIG results  %12.3f", Bytes(results));
+		Row("memory", "genotype", genotype);
+		Row("memory", "thread_buffers", threadMemory);
+		Row("memory", "best_ig_results", results);
+		total = genotype + threadMemory + results;
+		for (uint32 o = 0; o < MAX_ORDER - 1; o++)
+		{
+			printf("\n  purity %u-SNP    %12.3f", o + 1, Bytes(purity[o]));
+			sprintf(name, "purity_%u", o + 1);
+			Row("memory", name, purity[o]);
+			total += purity[o];
+		}
+		printf("\n  total           %12.3f (%.3f available)", Bytes(total), Bytes(available));
+		Row("memory", "total", total);
+
+		// calibrate the kernels on synthetic data with the same samples
+		dataset.Synthesize(PLAN_VARIABLE);
+		EpiStat epiStat;
+		epiStat.Init(&dataset, NULL, NULL, args, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+
+		double effective = threads < cpus ? threads : cpus;
+		double seconds = 0;
+		printf("\n\n Run time (seconds with %u threads)", threads);
+		for (uint32 o = 0; o < MAX_ORDER; o++)
+		{
+			if (!args.computeP[o])
+				continue;
+			double perCombination = epiStat.Calibrate(o);
+			double combinations = Combinations(n, o + 1);
+			double t = combinations * perCombination / effective;
+			seconds += t;
+			printf("\n  %u-SNP  %14.0f combinations  %10.3e s/combination  %14.1f s", o + 1, combinations, perCombination, t);
+			sprintf(name, "order_%u", o + 1);
+			Row("combinations", name, combinations);
+			Row("calibration", name, perCombination);
+			Row("time", name, t);
 		}
+		printf("\n  total %14.1f s", seconds);
+		Row("time", "total", seconds);
+
+		// recommendations
+		uint32 recommendThreads = cpus;
+		const char *pin = topology.numNode > 1 ? "scatter" : "cores";
+		const char *hugePages = genotype > 64.0 * 1024 * 1024 ? "thp" : "none";
+		bool fits = (available == 0) || (total < 0.9 * available);
+		printf("\n\n Recommended");
+		printf("\n  -t %u -pin %s%s%s%s", recommendThreads, pin, topology.numNode > 1 ? " -numa" : "", strcmp(hugePages, "none") ? " -hugePages " : "", strcmp(hugePages, "none") ? hugePages : "");
+		if (!fits)
+			printf("\n  *** the job does not fit in memory, lower the order or the number of threads");
+		Row("recommend", "threads", recommendThreads);
+		Row("recommend", "pin", pin);
+		Row("recommend", "numa", topology.numNode > 1 ? "true" : "false");
+		Row("recommend", "huge_pages", hugePages);
+		Row("recommend", "fits_memory", fits ? "true" : "false");
+		Row("recommend", "time", seconds * effective / (recommendThreads < cpus ? recommendThreads : cpus));
+		printf("\n");
 
-		FreePurity(dataset->numVariable, args);
-		dataset->FreeMemory(args);
+		fclose(csv);
+		dataset.FreeMemory();
+		return true;
 	}
 };
 
@@ -1686,7 +7103,176 @@ void *EpiThread_4(void *t)
 	return NULL;
 }
 
-int main(int argc, char *argv[])
+void *EpiThread_Fused(void *t)
+{
+	ThreadData *td = (ThreadData *)t;
+	EpiStat *epiStat = (EpiStat *)td->epiStat;
+	epiStat->Epi_Fused(td->id);
+	return NULL;
+}
+
+void *EpiThread_Split(void *t)
+{
+	ThreadData *td = (ThreadData *)t;
+	EpiStat *epiStat = (EpiStat *)td->epiStat;
+	epiStat->Epi_Split(td->id);
+	return NULL;
+}
+
+// A dataset loaded once and the purities saved by its runs. A session can be run
+// many times, from several threads at the same time, without reading the dataset again.
+class Session
+{
+	pthread_mutex_t lock;      // guards the purity table and the NUMA replicas
+	pthread_mutex_t saveLock;  // held by the run that saves purities
+	uint64 key;                // Dataset::Hash, computed by the first run with -cache
+	bool keyReady;
+
+	void CacheFile(ARGS &args, uint32 o, char *fn)
+	{
+		sprintf(fn, "%s/%016llx.purity.%u.bin", args.cache, (unsigned long long)key, o + 1);
+	}
+
+	// map the orders the run would save from the purity cache
+	void LoadCache(ARGS &args)
+	{
+		if (!keyReady)
+		{
+			key = dataset.Hash();
+			keyReady = true;
+		}
+
+		char fn[1100];
+		for (uint32 o = 0; o < MAX_ORDER - 1; o++)
+		{
+			if (!args.saveP[o] || purity.complete[o])
+				continue;
+			CacheFile(args, o, fn);
+			if (purity.Load(o, fn, key, dataset.numVariable))
+				printf("\nLoaded %u-SNP purity from %s", o + 1, fn);
+		}
+	}
+
+	// clear the save flags of the orders already saved, and whether the run still saves an order
+	bool PlanSaves(ARGS &args, bool report)
+	{
+		bool saves = false;
+		for (uint32 o = 0; o < MAX_ORDER - 1; o++)
+		{
+			if (!args.saveP[o])
+				continue;
+			if (purity.complete[o])
+			{
+				args.saveP[o] = false;
+				if (!args.printP[o] && !args.computeIG[o] && !args.bestIG && !args.UsesMetrics(o))
+					args.computeP[o] = false;
+				if (report)
+					printf("\nReusing saved %u-SNP purity", o + 1);
+			}
+			else
+				saves = true;
+		}
+		return saves;
+	}
+
+public:
+	Dataset dataset;
+	PurityTable purity;
+
+	Session()
+	{
+		keyReady = false;
+		pthread_mutex_init(&lock, NULL);
+		pthread_mutex_init(&saveLock, NULL);
+	}
+
+	~Session()
+	{
+		dataset.FreeMemory();
+		pthread_mutex_destroy(&lock);
+		pthread_mutex_destroy(&saveLock);
+	}
+
+	// false if the dataset cannot be read, the session is then only deleted
+	bool Load(ARGS args)
+	{
+		dataset.pageMode = args.hugePages;
+		if (!dataset.ReadDataset(args.input))
+			return false;
+		dataset.Recode(args.model);
+		if (args.collapse && !dataset.Collapse())
+			return false;
+		dataset.Init();
+		return true;
+	}
+
+	// the reported combinations go to stream instead of the output files unless it is NULL
+	int Run(ARGS args, volatile bool *cancel, OutputStream *stream)
+	{
+		Placement placement;
+		placement.Plan(args.numThreads, args.pinPolicy);
+
+		pthread_mutex_lock(&lock);
+		dataset.Replicate(&placement, args);
+		ARGS plan = args;
+		bool saves = false;
+		if (!args.OwnPurity()) // a run in its own order, or on more samples (-counts), saves its purities in a table of its own
+		{
+			saves = PlanSaves(plan, false);
+			if (!saves)
+			{
+				plan = args;
+				PlanSaves(plan, true);
+			}
+		}
+		pthread_mutex_unlock(&lock);
+
+		// runs that save purities go one at a time, the table is only read once an order is complete
+		if (saves)
+		{
+			pthread_mutex_lock(&saveLock);
+			pthread_mutex_lock(&lock);
+			if (strlen(args.cache))
+				LoadCache(args);
+			plan = args;
+			saves = PlanSaves(plan, true);
+			purity.Allocate(dataset.numVariable, dataset.numVariable, plan);
+			pthread_mutex_unlock(&lock);
+			if (!saves)
+				pthread_mutex_unlock(&saveLock);
+		}
+
+		EpiStat epiStat;
+		epiStat.Init(&dataset, &purity, &placement, plan, cancel, EpiThread_1, EpiThread_2, EpiThread_3, EpiThread_4, EpiThread_Fused, EpiThread_Split);
+		epiStat.stream = stream;
+		int result = epiStat.Run();
+
+		if (saves)
+		{
+			pthread_mutex_lock(&lock);
+			for (uint32 o = 0; o < MAX_ORDER - 1; o++)
+				if (plan.saveP[o] && !result)
+					purity.complete[o] = true;
+			pthread_mutex_unlock(&lock);
+
+			// the completed orders are only read from now on, and no other run saves until saveLock is released
+			char fn[1100];
+			for (uint32 o = 0; o < MAX_ORDER - 1; o++)
+			{
+				if (!plan.saveP[o] || result || !strlen(args.cache))
+					continue;
+				CacheFile(args, o, fn);
+				purity.Store(o, fn, key);
+			}
+			pthread_mutex_unlock(&saveLock);
+		}
+		return result;
+	}
+};
+
+// Run BitEpi with command line arguments. The run stops at the next work unit and returns RETURN_CANCELLED once *cancel is set,
+// or writes the results so far and returns RETURN_STOPPED once its -timeBudget runs out or stopSignal is set.
+int BitEpi(int argc, char *argv[], volatile bool *cancel)
 {
 	#ifdef PTEST
 		for (uint32 i = 0; i < 100; i++)
@@ -1697,17 +7283,19 @@ int main(int argc, char *argv[])
 	ARGS args;
 	args.Parse(argc, argv);
 	//args.Print();
-	
-	Dataset dataset;
-	dataset.ReadDataset(args.input);
-	dataset.Init(args);
-
-	AllocatePurity(dataset.numVariable, args);
 
-	EpiStat epiStat;
-	epiStat.Init(&dataset, args, EpiThread_1, EpiThread_2, EpiThread_3, EpiThread_4);
-
-	epiStat.Run();
+	if (args.plan)
+	{
+		Planner planner;
+		return planner.Run(args) ? 0 : RETURN_INVALID;
+	}
+	
+	Session session;
+	if (!session.Load(args))
+		return RETURN_INVALID;
+	int result = session.Run(args, cancel, NULL);
+	if (result)
+		return result;
 
 	printf("\n=============Finish=============\n\n\n");
 
@@ -1731,3 +7319,11 @@ int main(int argc, char *argv[])
 	#endif
 	return 0;
 }
+
+int main(int argc, char *argv[])
+{
+	static volatile bool cancel = false;
+	signal(SIGINT, StopOnSignal);
+	signal(SIGTERM, StopOnSignal);
+	return BitEpi(argc, argv, &cancel);
+}
@@ -0,0 +1,42 @@
+#ifndef GZWRITER_H
+#define GZWRITER_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A streaming gzip (deflate, fixed Huffman codes) writer, so no zlib is needed.
+// Files written by several writers can be concatenated into a valid gzip file.
+typedef struct GzWriter {
+    FILE *fileHandler_;
+    unsigned char *in_;      // input of the current block
+    size_t inLen_;
+    unsigned char *out_;     // compressed bytes not written yet
+    size_t outLen_;
+    unsigned long long bitBuffer_;
+    int bitCount_;
+    unsigned int crc_;
+    unsigned int size_;      // input size modulo 2^32
+    int *head_;              // last position of each hash in the block
+    int *prev_;              // previous position of the same hash
+    int error_;              // a write to the file failed
+} GzWriter;
+
+
+// Public
+GzWriter *GzWriter_new(const char *filePath, const char *mode);
+int GzWriter_write(GzWriter *gzWriter, const void *data, size_t len);
+int GzWriter_close(GzWriter *gzWriter);
+
+// Private
+void _GzWriter_compressBlock(GzWriter *gzWriter, int last);
+void _GzWriter_putBits(GzWriter *gzWriter, unsigned int value, int count);
+int _GzWriter_flushOutput(GzWriter *gzWriter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,33 +5,282 @@
 
 #include "BitEpi.cpp"
 
-static PyObject * main_wrapper(PyObject * self, PyObject * args)
+// A handle on a running analysis, used to cancel it from another thread.
+typedef struct {
+    PyObject_HEAD
+    volatile bool cancelled;
+} JobObject;
+
+static PyObject * Job_cancel(JobObject * self, PyObject * Py_UNUSED(ignored))
 {
-    int result;
-    char *delim;
-    char *argchars;
-    char *token;
-    char *saveptr;
-    PyObject *ret;
-    std::vector<char *> argvect;
+    self->cancelled = true;
+    Py_RETURN_NONE;
+}
 
-    // parse arguments
-    if (!PyArg_ParseTuple(args, "ss", &delim, &argchars)) {
+static PyObject * Job_get_cancelled(JobObject * self, void * closure)
+{
+    return PyBool_FromLong(self->cancelled);
+}
+
+static PyMethodDef JobMethods[] = {
+    { "cancel", (PyCFunction)Job_cancel, METH_NOARGS,
+      "Stop the analysis at the next work unit" },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyGetSetDef JobGetSet[] = {
+    { "cancelled", (getter)Job_get_cancelled, NULL,
+      "Whether cancel has been called", NULL },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyTypeObject JobType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+
+// The reported combinations of a run, read in batches while it runs.
+typedef struct {
+    PyObject_HEAD
+    OutputStream *stream;
+} StreamObject;
+
+static int Stream_init(StreamObject * self, PyObject * args, PyObject * kwds)
+{
+    if (self->stream == NULL) {
+        self->stream = new OutputStream();
+    }
+    return 0;
+}
+
+static void Stream_dealloc(StreamObject * self)
+{
+    delete self->stream;
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+// The next batch as (output, order, values, variables), waiting for one
+// without holding the GIL, or None once the run has finished.
+static PyObject * Stream_get(StreamObject * self, PyObject * Py_UNUSED(ignored))
+{
+    StreamBatch *batch;
+    OutputStream *stream = self->stream;
+    Py_BEGIN_ALLOW_THREADS
+    batch = stream->Get();
+    Py_END_ALLOW_THREADS
+    if (batch == NULL) {
+        Py_RETURN_NONE;
+    }
+    PyObject *ret = Py_BuildValue(
+        "sIy#y#", outName[batch->metric], batch->order,
+        (const char *)batch->value,
+        (Py_ssize_t)(batch->numRecord * sizeof(double)),
+        (const char *)batch->idx,
+        (Py_ssize_t)((uint64)batch->numRecord * (batch->order + 1)
+                     * sizeof(varIdx)));
+    OutputStream::FreeBatch(batch);
+    return ret;
+}
+
+static PyObject * Stream_names(StreamObject * self,
+                               PyObject * Py_UNUSED(ignored))
+{
+    OutputStream *stream = self->stream;
+    PyObject *names = PyList_New(stream->numName);
+    if (names == NULL) {
         return NULL;
     }
-    int j;
-    for (j=1; ; j++, argchars = NULL)
+    for (varIdx i = 0; i < stream->numName; i++) {
+        PyObject *name = PyUnicode_FromString(stream->names[i]);
+        if (name == NULL) {
+            Py_DECREF(names);
+            return NULL;
+        }
+        PyList_SET_ITEM(names, i, name);
+    }
+    return names;
+}
+
+static PyObject * Stream_finish(StreamObject * self,
+                                PyObject * Py_UNUSED(ignored))
+{
+    self->stream->Finish();
+    Py_RETURN_NONE;
+}
+
+static PyObject * Stream_close(StreamObject * self,
+                               PyObject * Py_UNUSED(ignored))
+{
+    self->stream->Close();
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef StreamMethods[] = {
+    { "get", (PyCFunction)Stream_get, METH_NOARGS,
+      "Wait for the next batch, None once the run has finished" },
+    { "names", (PyCFunction)Stream_names, METH_NOARGS,
+      "Names of the variables indexed by the batches" },
+    { "finish", (PyCFunction)Stream_finish, METH_NOARGS,
+      "Mark the end of the batches, once the run has returned" },
+    { "close", (PyCFunction)Stream_close, METH_NOARGS,
+      "Stop reading, the remaining batches are dropped" },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyTypeObject StreamType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+
+// Split a copy of argchars on delim, the buffer of a Python string must not
+// be modified.
+static void split_args(const char *delim, const char *argchars,
+                       std::vector<char> &argbuffer,
+                       std::vector<char *> &argvect)
+{
+    char *token;
+    char *saveptr;
+    argbuffer.assign(argchars, argchars + strlen(argchars) + 1);
+    std::vector<char> delimbuffer(delim, delim + strlen(delim) + 1);
+    char *argstring = &argbuffer[0];
+    for (; ; argstring = NULL)
     {
-        token = strtok_r(argchars, delim, &saveptr);
+        token = strtok_r(argstring, &delimbuffer[0], &saveptr);
         if (token == NULL)
         {
             break;
         }
         argvect.push_back(token);
     }
+}
+
+// A dataset loaded once, and the purities saved by its runs.
+typedef struct {
+    PyObject_HEAD
+    Session *session;
+} SessionObject;
+
+static int Session_init(SessionObject * self, PyObject * args,
+                        PyObject * kwds)
+{
+    char *delim;
+    char *argchars;
+    std::vector<char> argbuffer;
+    std::vector<char *> argvect;
+
+    if (!PyArg_ParseTuple(args, "ss", &delim, &argchars)) {
+        return -1;
+    }
+    if (self->session != NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Session already loaded");
+        return -1;
+    }
+    split_args(delim, argchars, argbuffer, argvect);
 
-    // run the actual function
-    result = main(int(argvect.size()), &argvect[0]);
+    // read the dataset without holding the GIL
+    Session *session;
+    bool loaded;
+    Py_BEGIN_ALLOW_THREADS
+    ARGS loadArgs;
+    loadArgs.Parse(int(argvect.size()), &argvect[0], true, false);
+    session = new Session();
+    loaded = session->Load(loadArgs);
+    if (!loaded) {
+        delete session;
+    }
+    Py_END_ALLOW_THREADS
+    if (!loaded) {
+        PyErr_SetString(PyExc_ValueError,
+                        "BitEpi cannot read the dataset, see its output");
+        return -1;
+    }
+    self->session = session;
+    return 0;
+}
+
+static void Session_dealloc(SessionObject * self)
+{
+    delete self->session;
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject * Session_run(SessionObject * self, PyObject * args)
+{
+    int result;
+    char *delim;
+    char *argchars;
+    JobObject *job = NULL;
+    StreamObject *stream = NULL;
+    std::vector<char> argbuffer;
+    std::vector<char *> argvect;
+    volatile bool notCancelled = false;
+
+    if (!PyArg_ParseTuple(args, "ss|O!O!", &delim, &argchars, &JobType,
+                          &job, &StreamType, &stream)) {
+        return NULL;
+    }
+    if (self->session == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Session is not loaded");
+        return NULL;
+    }
+    split_args(delim, argchars, argbuffer, argvect);
+
+    // runs of a session may overlap, each one without holding the GIL
+    volatile bool *cancel = job ? &job->cancelled : &notCancelled;
+    Session *session = self->session;
+    OutputStream *outputStream = stream ? stream->stream : NULL;
+    Py_BEGIN_ALLOW_THREADS
+    ARGS runArgs;
+    runArgs.Parse(int(argvect.size()), &argvect[0], false, true);
+    result = session->Run(runArgs, cancel, outputStream);
+    Py_END_ALLOW_THREADS
+
+    if (result == RETURN_INVALID) {
+        PyErr_SetString(PyExc_ValueError,
+                        "BitEpi cannot use a file of the run, see its output");
+        return NULL;
+    }
+    return PyLong_FromLong(result);
+}
+
+static PyMethodDef SessionMethods[] = {
+    { "run", (PyCFunction)Session_run, METH_VARARGS,
+      "Analyse the loaded dataset with BitEpi, into a Stream if given" },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyTypeObject SessionType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+
+static PyObject * main_wrapper(PyObject * self, PyObject * args)
+{
+    int result;
+    char *delim;
+    char *argchars;
+    PyObject *ret;
+    JobObject *job = NULL;
+    std::vector<char> argbuffer;
+    std::vector<char *> argvect;
+    volatile bool notCancelled = false;
+
+    // parse arguments
+    if (!PyArg_ParseTuple(args, "ss|O!", &delim, &argchars, &JobType,
+                          &job)) {
+        return NULL;
+    }
+
+    split_args(delim, argchars, argbuffer, argvect);
+
+    // run the actual function without holding the GIL
+    volatile bool *cancel = job ? &job->cancelled : &notCancelled;
+    Py_BEGIN_ALLOW_THREADS
+    result = BitEpi(int(argvect.size()), &argvect[0], cancel);
+    Py_END_ALLOW_THREADS
+
+    if (result == RETURN_INVALID) {
+        PyErr_SetString(PyExc_ValueError,
+                        "BitEpi cannot use its input, see its output");
+        return NULL;
+    }
 
     // build the resulting string into a Python object.
     ret = PyLong_FromLong(result);
@@ -54,5 +303,67 @@ static struct PyModuleDef BitEpiModule = {
 
 PyMODINIT_FUNC PyInit_bitepimodule(void)
 {
-    return PyModule_Create(&BitEpiModule);
+    PyObject *module;
+
+    JobType.tp_name = "bitepimodule.Job";
+    JobType.tp_doc = "Cancellation handle of a BitEpi analysis";
+    JobType.tp_basicsize = sizeof(JobObject);
+    JobType.tp_flags = Py_TPFLAGS_DEFAULT;
+    JobType.tp_new = PyType_GenericNew;
+    JobType.tp_methods = JobMethods;
+    JobType.tp_getset = JobGetSet;
+    if (PyType_Ready(&JobType) < 0) {
+        return NULL;
+    }
+
+    StreamType.tp_name = "bitepimodule.Stream";
+    StreamType.tp_doc = "The reported combinations of a BitEpi analysis";
+    StreamType.tp_basicsize = sizeof(StreamObject);
+    StreamType.tp_flags = Py_TPFLAGS_DEFAULT;
+    StreamType.tp_new = PyType_GenericNew;
+    StreamType.tp_init = (initproc)Stream_init;
+    StreamType.tp_dealloc = (destructor)Stream_dealloc;
+    StreamType.tp_methods = StreamMethods;
+    if (PyType_Ready(&StreamType) < 0) {
+        return NULL;
+    }
+
+    SessionType.tp_name = "bitepimodule.Session";
+    SessionType.tp_doc = "A dataset loaded once for several BitEpi analyses";
+    SessionType.tp_basicsize = sizeof(SessionObject);
+    SessionType.tp_flags = Py_TPFLAGS_DEFAULT;
+    SessionType.tp_new = PyType_GenericNew;
+    SessionType.tp_init = (initproc)Session_init;
+    SessionType.tp_dealloc = (destructor)Session_dealloc;
+    SessionType.tp_methods = SessionMethods;
+    if (PyType_Ready(&SessionType) < 0) {
+        return NULL;
+    }
+
+    module = PyModule_Create(&BitEpiModule);
+    if (module == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(&JobType);
+    if (PyModule_AddObject(module, "Job", (PyObject *)&JobType) < 0) {
+        Py_DECREF(&JobType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&SessionType);
+    if (PyModule_AddObject(module, "Session", (PyObject *)&SessionType) < 0) {
+        Py_DECREF(&SessionType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&StreamType);
+    if (PyModule_AddObject(module, "Stream", (PyObject *)&StreamType) < 0) {
+        Py_DECREF(&StreamType);
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
 }
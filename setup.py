@@ -7,6 +7,7 @@ bitepi_ext = Extension(
     sources=[
         'bitepi/source/wrapper.cpp',
         'bitepi/source/csvparser.c',
+        'bitepi/source/gzwriter.c',
     ],
     extra_compile_args=[
         '-O3',
@@ -0,0 +1,27 @@
+// Checks FormatValue against printf("%f") around the values where its rounding changes width.
+#define main bitepi_main
+#include "../bitepi/source/BitEpi.cpp"
+#undef main
+
+int main()
+{
+	const double values[] = {
+		0, -0.0, 0.0000005, 0.0000015, 9.9999995, 99.9999996, 123.456789,
+		999.999999, 999.9999994, 999.9999995, 999.9999996, 999.99999999, 1000, 1234.5,
+		-999.9999996, -999.999999, -0.5,
+	};
+	int failed = 0;
+	for (double v : values)
+	{
+		char expected[64], actual[64];
+		sprintf(expected, "%f", v);
+		uint32 len = FormatValue(actual, v);
+		actual[len] = 0;
+		if (strcmp(expected, actual) != 0)
+		{
+			printf("FormatValue(%.10f): expected %s, got %s\n", v, expected, actual);
+			failed++;
+		}
+	}
+	return failed != 0;
+}
@@ -0,0 +1,39 @@
+// Checks RecordOrder against sort -g -r on the rows: values equal as printed are ordered by their names.
+#define main bitepi_main
+#include "../bitepi/source/BitEpi.cpp"
+#undef main
+
+int main()
+{
+	char snp1[] = "snp1", snp3[] = "snp3", snp5[] = "snp5", snp12[] = "snp12";
+	char *names[] = {snp1, snp3, snp5, snp12};
+	RecordOrder ro;
+	ro.names = names;
+	ro.order = 2;
+
+	// both print as 0.580723
+	SortRecord a = {0.5807226, {1, 2, 3}}; // snp3,snp5,snp12
+	SortRecord b = {0.5807234, {0, 1, 3}}; // snp1,snp3,snp12
+	// prints as 0.580724
+	SortRecord c = {0.5807236, {0, 1, 2}};
+	SortRecord zero = {0.0, {0, 1, 2}};
+	SortRecord negativeZero = {-0.0000001, {1, 2, 3}};
+
+	int failed = 0;
+	if (!ro.Before(a, b) || ro.Before(b, a))
+	{
+		printf("0.5807226,snp3,snp5,snp12 should go before 0.5807234,snp1,snp3,snp12\n");
+		failed++;
+	}
+	if (!ro.Before(c, a) || !ro.Before(c, b))
+	{
+		printf("0.5807236 should go before the values printed as 0.580723\n");
+		failed++;
+	}
+	if (!ro.Before(zero, negativeZero) || ro.Before(negativeZero, zero))
+	{
+		printf("0.000000 should go before -0.000000\n");
+		failed++;
+	}
+	return failed != 0;
+}
@@ -0,0 +1,36 @@
+import os
+import shutil
+import subprocess
+import tempfile
+import unittest
+
+TESTS = os.path.dirname(os.path.abspath(__file__))
+SOURCE = os.path.join(TESTS, '..', 'bitepi', 'source')
+
+
+def run_check(test, name):
+    with tempfile.TemporaryDirectory() as tmp:
+        binary = os.path.join(tmp, name)
+        subprocess.run(
+            ['c++', '-O2', '-pthread', '-w', '-o', binary,
+             os.path.join(TESTS, name + '.cpp'),
+             os.path.join(SOURCE, 'csvparser.c'),
+             os.path.join(SOURCE, 'gzwriter.c')],
+            check=True)
+        result = subprocess.run([binary], stdout=subprocess.PIPE,
+                                universal_newlines=True)
+        test.assertEqual(result.returncode, 0, result.stdout)
+
+
+class FormatValueTest(unittest.TestCase):
+    @unittest.skipUnless(shutil.which('c++'), 'needs a C++ compiler')
+    def test_matches_printf(self):
+        run_check(self, 'format_value')
+
+    @unittest.skipUnless(shutil.which('c++'), 'needs a C++ compiler')
+    def test_sort_ties_by_printed_value(self):
+        run_check(self, 'record_order')
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,50 @@
+import os
+import random
+import tempfile
+import unittest
+
+try:
+    import bitepi
+except ImportError:
+    bitepi = None
+
+
+@unittest.skipIf(bitepi is None, 'needs the bitepimodule extension')
+class ResumeTest(unittest.TestCase):
+    def setUp(self):
+        rng = random.Random(0)
+        self.samples = ['S{}'.format(i) for i in range(300)]
+        self.cases = [[sample, rng.randint(0, 1)] for sample in self.samples]
+        self.genotypes = [[rng.randint(0, 2) for _ in self.samples]
+                          for _ in range(10)]
+        # snp5 ties with snp4 in every combination, the dataset order
+        # keeps snp4
+        self.genotypes[5] = list(self.genotypes[4])
+        self.directory = tempfile.TemporaryDirectory()
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def epistasis(self, snps):
+        genotype_array = [['SNP'] + self.samples] + [
+            ['snp{}'.format(i)] + self.genotypes[i] for i in snps]
+        return bitepi.Epistasis(genotype_array, self.cases,
+                                working_directory=self.directory.name)
+
+    def test_interleaved_snps_with_duplicate(self):
+        for best_ig in (True, 3):
+            state = os.path.join(self.directory.name,
+                                 'state{}'.format(best_ig))
+            # the new SNPs fall between the SNPs of the state, snp4 is new
+            # and snp5 is not
+            self.epistasis(range(1, 10, 2)).compute_epistasis(
+                best_ig=best_ig, threads=1, save_state=state)
+            full = self.epistasis(range(10))
+            resumed = full.compute_epistasis(best_ig=best_ig, threads=2,
+                                             resume=state)
+            expected = full.compute_epistasis(best_ig=best_ig, threads=2)
+            self.assertTrue(resumed['best_ig'].equals(expected['best_ig']))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,64 @@
+import os
+import random
+import tempfile
+import unittest
+
+try:
+    import bitepi
+except ImportError:
+    bitepi = None
+
+
+def make_epistasis(genotypes, working_directory):
+    """Build an Epistasis of random cases from rows of genotypes."""
+    num_sample = len(genotypes[0])
+    samples = ['S{}'.format(i) for i in range(num_sample)]
+    rng = random.Random(1)
+    sample_array = [[sample, rng.randint(0, 1)] for sample in samples]
+    genotype_array = [['SNP'] + samples] + [
+        ['snp{}'.format(i)] + row for i, row in enumerate(genotypes)]
+    return bitepi.Epistasis(genotype_array, sample_array,
+                            working_directory=working_directory)
+
+
+@unittest.skipIf(bitepi is None, 'needs the bitepimodule extension')
+class SessionTest(unittest.TestCase):
+    def setUp(self):
+        rng = random.Random(0)
+        self.genotypes = [[rng.randint(0, 2) for _ in range(200)]
+                          for _ in range(8)]
+        self.directory = tempfile.TemporaryDirectory()
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def compute(self, epistasis, **kwargs):
+        result = epistasis.compute_epistasis(p1=0, p2=0, threads=1, **kwargs)
+        return {key: sorted(map(tuple, result[key].values.tolist()))
+                for key in result}
+
+    def test_model_reloads_dataset(self):
+        shared = make_epistasis(self.genotypes, self.directory.name)
+        codominant = self.compute(shared)
+        recessive = self.compute(shared, model='recessive')
+        self.assertNotEqual(codominant, recessive)
+        self.assertEqual(recessive, self.compute(
+            make_epistasis(self.genotypes, self.directory.name),
+            model='recessive'))
+        self.assertEqual(codominant, self.compute(shared))
+
+    def test_invalid_file_raises(self):
+        epistasis = make_epistasis(self.genotypes, self.directory.name)
+        state = os.path.join(self.directory.name, 'invalid.state')
+        with open(state, 'wb') as f:
+            f.write(b'not a state')
+        with self.assertRaises(ValueError):
+            epistasis.compute_epistasis(best_ig=True, resume=state)
+        with self.assertRaises(ValueError):
+            epistasis.compute_epistasis(p2=0, targets=['absent'])
+        # the session is still usable
+        self.assertTrue(self.compute(epistasis))
+
+
+if __name__ == '__main__':
+    unittest.main()